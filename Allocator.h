@@ -11,21 +11,413 @@
 // includes
 // --------
 
+#include <algorithm> // copy, max, min
 #include <cassert>   // assert
 #include <cstddef>   // ptrdiff_t, size_t
 #include <new>       // bad_alloc, new
 #include <stdexcept> // invalid_argument
 #include <cmath>     // absolute value
+#include <cstdlib>   // abs
+#include <cstdint>   // uintptr_t
+#include <iterator>  // input_iterator_tag
+#include <utility>   // move
+
+#include "Arena.h"
+
+// ALLOCATOR_STATS is the default of BasicAllocator's STATS parameter, which
+// keeps the allocation counters and the scan-length histogram; it is on
+// unless defined to 0, and NDEBUG leaves it alone
+// it picks the type Allocator<T, N> names, so every translation unit that
+// shares one must see the same ALLOCATOR_STATS
+#ifndef ALLOCATOR_STATS
+#define ALLOCATOR_STATS 1
+#endif
+
+// --------------
+// AllocatorStats
+// --------------
+
+/**
+ * A snapshot of a heap, from BasicAllocator::stats().
+ * The block and byte counts come from a walk of the heap and are always
+ * filled in; the counters stay 0 unless the allocator's STATS is true.
+ * A slab counts as one live block, whether or not its slots are in use.
+ */
+struct AllocatorStats {
+    // scans[0] counts searches that examined no free block,
+    // scans[b] those that examined [2^(b-1), 2^b), the last everything longer
+    static const int SCAN_BUCKETS = 16;
+
+    std::size_t live_blocks;
+    std::size_t live_bytes;
+    std::size_t free_blocks;
+    std::size_t free_bytes;
+    std::size_t largest_free;
+
+    std::size_t allocations;
+    std::size_t deallocations;
+    std::size_t failed_allocations;
+    std::size_t scans[SCAN_BUCKETS];
+
+    /**
+     * O(1) in space
+     * O(1) in time
+     * External fragmentation: the share of the free bytes that aren't in the
+     * largest free block, 0 if nothing is free.
+     */
+    double fragmentation () const {
+        return (free_bytes == 0) ? 0 : 1 - static_cast<double>(largest_free) / free_bytes;}
+
+    /**
+     * O(1) in space
+     * O(log n) in time
+     * Returns the histogram bucket of a search that examined n free blocks.
+     */
+    static int bucket (std::size_t n) {
+        int b = 0;
+        while (n != 0 && b < SCAN_BUCKETS - 1) {
+            n >>= 1;
+            ++b;}
+        return b;}};
+
+// ------------
+// HeapCounters
+// ------------
+
+/**
+ * The counters a BasicAllocator keeps for stats() when STATS is true.
+ */
+template <bool STATS>
+class HeapCounters {
+    private:
+        // ----
+        // data
+        // ----
 
-// ---------
-// Allocator
-// ---------
+        // the walk fields are left 0
+        AllocatorStats counters;
+
+        // free blocks examined by the current search
+        mutable std::size_t scan_length;
+
+    protected:
+        HeapCounters () :
+            counters    (),
+            scan_length (0)
+        {}
+
+        void start_scan () const {
+            scan_length = 0;}
+
+        void examined () const {
+            ++scan_length;}
+
+        void end_scan () {
+            ++counters.scans[AllocatorStats::bucket(scan_length)];}
+
+        void allocated (std::size_t k) {
+            counters.allocations += k;}
+
+        void deallocated (std::size_t k) {
+            counters.deallocations += k;}
+
+        void failed () {
+            ++counters.failed_allocations;}
+
+        AllocatorStats counted () const {
+            return counters;}
+
+        void clear () {
+            counters = AllocatorStats();}};
+
+/**
+ * When STATS is false nothing is counted, and the empty base takes no space
+ * in the allocator.
+ */
+template <>
+class HeapCounters<false> {
+    protected:
+        void start_scan  () const {}
+        void examined    () const {}
+        void end_scan    () {}
+        void allocated   (std::size_t) {}
+        void deallocated (std::size_t) {}
+        void failed      () {}
+
+        AllocatorStats counted () const {
+            return AllocatorStats();}
+
+        void clear () {}};
+
+/**
+ * O(1) in space
+ * O(log x) in time, at compile time
+ * Returns the index of the highest set bit of x, 0 if x is 0.
+ */
+constexpr int floor_log2 (unsigned long long x) {
+    return (x < 2) ? 0 : 1 + floor_log2(x / 2);}
+
+/**
+ * O(1) in space
+ * O(log x) in time, at compile time
+ * Returns the smallest power of two at least x.
+ */
+constexpr unsigned long long ceil_pow2 (unsigned long long x) {
+    return (x < 2) ? 1 : 2ull << floor_log2(x - 1);}
+
+// ------------------
+// placement policies
+// ------------------
+
+/**
+ * A placement policy picks the free block allocate carves from.
+ * find returns the index of a free block of at least bytes bytes, -1 if none.
+ * It reads the size of each candidate with examine, which counts it toward
+ * the search's scan length. The lists are ordered by size, and next_class
+ * finds the next non-empty one in O(1).
+ * unlinked is called whenever a block leaves its free list, so policies that
+ * remember blocks across calls can forget it.
+ */
+
+// --------
+// FirstFit
+// --------
 
-template <typename T, int N>
-class Allocator {
+/**
+ * The first block on the request's free list that fits,
+ * otherwise the head of the next non-empty bigger list.
+ */
+struct FirstFit {
+    /**
+     * O(1) in space
+     * O(k) in time, k the length of one free list
+     */
+    template <typename H>
+    typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+        typedef typename H::sentinel_type sentinel_type;
+        int c = h.size_class(std::max(bytes, h.LINK_SIZE));
+        for (sentinel_type i = h.free_lists[c]; i != -1; i = h.next_free(i))
+            if (h.examine(i) >= bytes)
+                return i;
+        // every block on a bigger list fits
+        c = h.next_class(c + 1);
+        if (c == -1)
+            return -1;
+        h.examine(h.free_lists[c]);
+        return h.free_lists[c];}
+
+    template <typename H>
+    void unlinked (const H&, typename H::sentinel_type) {}};
+
+// -------
+// NextFit
+// -------
+
+/**
+ * Like FirstFit, but each list is scanned from where the last search stopped,
+ * wrapping around to its head, so repeated requests don't rescan the same
+ * too-small blocks at the front.
+ */
+class NextFit {
+    private:
+        // the free block the next search starts from, -1 if none
+        std::ptrdiff_t rover;
 
-    const int SENTINEL_SIZE =   sizeof(int);
-    const int T_SIZE =          sizeof(T);
+    public:
+        NextFit () :
+            rover (-1)
+        {}
+
+        /**
+         * O(1) in space
+         * O(k) in time, k the length of one free list
+         */
+        template <typename H>
+        typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+            typedef typename H::sentinel_type sentinel_type;
+            for (int c = h.next_class(h.size_class(std::max(bytes, h.LINK_SIZE))); c != -1; c = h.next_class(c + 1)) {
+                sentinel_type head = h.free_lists[c];
+                sentinel_type start = (rover != -1 && h.size_class(h.view(rover)) == c) ? rover : head;
+                sentinel_type i = start;
+                do {
+                    // allocate unlinks it, which moves the rover past it
+                    if (h.examine(i) >= bytes)
+                        return rover = i;
+                    i = h.next_free(i);
+                    if (i == -1)
+                        i = head;
+                } while (i != start);
+            }
+            return -1;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Move the rover past a block that is leaving its list.
+         */
+        template <typename H>
+        void unlinked (const H& h, typename H::sentinel_type i) {
+            if (rover == i)
+                rover = h.next_free(i);}};
+
+// -------
+// BestFit
+// -------
+
+/**
+ * The smallest block that fits. Blocks on a bigger list are always bigger,
+ * so only the first list with a fitting block has to be scanned in full.
+ */
+struct BestFit {
+    /**
+     * O(1) in space
+     * O(k) in time, k the length of one free list
+     */
+    template <typename H>
+    typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+        typedef typename H::sentinel_type sentinel_type;
+        for (int c = h.next_class(h.size_class(std::max(bytes, h.LINK_SIZE))); c != -1; c = h.next_class(c + 1)) {
+            sentinel_type best = -1;
+            for (sentinel_type i = h.free_lists[c]; i != -1; i = h.next_free(i)) {
+                sentinel_type v = h.examine(i);
+                if (v == bytes)
+                    return i;
+                if (v > bytes && (best == -1 || v < h.view(best)))
+                    best = i;
+            }
+            if (best != -1)
+                return best;
+        }
+        return -1;}
+
+    template <typename H>
+    void unlinked (const H&, typename H::sentinel_type) {}};
+
+// -------
+// GoodFit
+// -------
+
+/**
+ * The head of the first non-empty list whose every block fits, so no list
+ * is ever scanned. Falls back to scanning the request's own list only when
+ * nothing bigger is free.
+ */
+struct GoodFit {
+    /**
+     * O(1) in space
+     * O(1) in time, unless the fallback scan is needed
+     */
+    template <typename H>
+    typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+        typedef typename H::sentinel_type sentinel_type;
+        int c = h.size_class(std::max(bytes, h.LINK_SIZE));
+        int k = h.next_class((bytes <= h.class_min(c)) ? c : c + 1);
+        if (k != -1) {
+            h.examine(h.free_lists[k]);
+            return h.free_lists[k];}
+        for (sentinel_type i = h.free_lists[c]; i != -1; i = h.next_free(i))
+            if (h.examine(i) >= bytes)
+                return i;
+        return -1;}
+
+    template <typename H>
+    void unlinked (const H&, typename H::sentinel_type) {}};
+
+// -----------
+// TwoLevelFit
+// -----------
+
+/**
+ * TLSF's good fit: GoodFit without the fallback scan, so every search is
+ * O(1) whatever the heap's size or layout. If no list is wholly big enough,
+ * only the head of the request's own list is tried, so a request can fail
+ * while a block deeper in that list would fit; at most one list's worth of
+ * sizes, 1/8 of the request, is given up for the bound.
+ */
+struct TwoLevelFit {
+    /**
+     * O(1) in space
+     * O(1) in time, at most one block examined
+     */
+    template <typename H>
+    typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+        typedef typename H::sentinel_type sentinel_type;
+        int c = h.size_class(std::max(bytes, h.LINK_SIZE));
+        int k = h.next_class((bytes <= h.class_min(c)) ? c : c + 1);
+        if (k != -1) {
+            h.examine(h.free_lists[k]);
+            return h.free_lists[k];}
+        sentinel_type i = h.free_lists[c];
+        if (i != -1 && h.examine(i) >= bytes)
+            return i;
+        return -1;}
+
+    template <typename H>
+    void unlinked (const H&, typename H::sentinel_type) {}};
+
+// --------------
+// BasicAllocator
+// --------------
+
+/**
+ * The boundary-tag heap, over any Arena.
+ * An Arena supplies the storage, data() and size(), the sentinel_type the
+ * heap's sentinels and offsets are stored as, and align(), which trims it
+ * so the payload after the first sentinel falls on a given boundary.
+ * STATS keeps the counters of stats(); without it they take no space.
+ */
+template <typename T, typename Arena, typename Policy = FirstFit, int SLAB_SLOTS = 0, std::size_t ALIGN = alignof(T), bool STATS = (ALLOCATOR_STATS != 0)>
+class BasicAllocator : private HeapCounters<STATS> {
+    // policies walk the free lists directly
+    friend Policy;
+
+    typedef typename Arena::sentinel_type sentinel_type;
+
+    static_assert((ALIGN & (ALIGN - 1)) == 0, "ALIGN must be a power of two");
+    static_assert(ALIGN >= alignof(T),        "ALIGN must be at least alignof(T)");
+    static_assert(ALIGN <= 64,                "ALIGN must be at most a cache line");
+
+    static constexpr sentinel_type SENTINEL_SIZE = sizeof(sentinel_type);
+    static constexpr sentinel_type T_SIZE =        sizeof(T);
+
+    // the smallest payload, so every free block can hold its prev/next links
+    static constexpr sentinel_type LINK_SIZE =     2 * sizeof(sentinel_type);
+
+    // the free lists are a two-level index: first-level class f holds blocks
+    // of [LINK_SIZE << f, LINK_SIZE << (f + 1)) bytes, the last one everything
+    // bigger, and each is split into SL_CLASSES lists of equal width;
+    // list c is second-level list c % SL_CLASSES of class c / SL_CLASSES;
+    // only as many first-level classes as the arena's largest block needs,
+    // and at most 28 for int sentinels, so LINK_SIZE << 27 still fits
+    static const int FL_WIDEST =  sizeof(sentinel_type) * 8 - 4 - sizeof(sentinel_type) / 8;
+    static const int FL_CLASSES = (floor_log2(Arena::MAX_SIZE / LINK_SIZE) + 1 < FL_WIDEST) ?
+                                  floor_log2(Arena::MAX_SIZE / LINK_SIZE) + 1 : FL_WIDEST;
+    static const int SL_BITS =    3;
+    static const int SL_CLASSES = 1 << SL_BITS;
+    static const int FREE_CLASSES = FL_CLASSES * SL_CLASSES;
+
+    // alignment of every payload, at least a sentinel's; blocks, sentinels
+    // included, are sized in multiples of GRID, so every sentinel is aligned
+    static const int GRID =     (ALIGN > sizeof(sentinel_type)) ? ALIGN : sizeof(sentinel_type);
+
+    // a slab slot holds a T, ALIGN aligned
+    static constexpr sentinel_type SLOT_SIZE =     (sizeof(T) + ALIGN - 1) & ~(ALIGN - 1);
+
+    // a slab is a used block whose payload starts with a header: the
+    // free-list links, which chain the slabs with a free slot, then a
+    // bitmap of its free slots
+    static const int SLAB_WORDS = (SLAB_SLOTS + 31) / 32;
+    static constexpr sentinel_type SLAB_HEADER =   (LINK_SIZE + (SLAB_WORDS * sizeof(std::uint32_t)) + GRID - 1) & ~(GRID - 1);
+
+    // a slab's left sentinel is on a SLAB_SPAN boundary of the arena and its
+    // slots end within the span, so a slot's slab is its offset rounded down;
+    // a whole slab fills its span, so slabs tile without gaps
+    static constexpr sentinel_type SLAB_SPAN =     ceil_pow2((2 * SENTINEL_SIZE) + SLAB_HEADER + (SLAB_SLOTS * SLOT_SIZE));
+
+    // the slots of a whole slab: at least SLAB_SLOTS, as many as fit in the
+    // span and the bitmap
+    static const int SLAB_CAPACITY = ((SLAB_SPAN - (2 * SENTINEL_SIZE) - SLAB_HEADER) / SLOT_SIZE < 32 * SLAB_WORDS) ?
+                                     (SLAB_SPAN - (2 * SENTINEL_SIZE) - SLAB_HEADER) / SLOT_SIZE : 32 * SLAB_WORDS;
 
 
     public:
@@ -44,28 +436,99 @@ class Allocator {
         typedef       value_type&       reference;
         typedef const value_type& const_reference;
 
+        // -----
+        // block
+        // -----
+
+        /**
+         * One block of the heap, as seen by a heap walk.
+         * A used block may be a slab of single-object slots.
+         */
+        struct block {
+            std::size_t offset;         // of its left sentinel in the arena
+            std::size_t bytes;          // of payload
+            bool        used;
+            const void* payload;};
+
+        // --------------
+        // block_iterator
+        // --------------
+
+        /**
+         * Walks the heap's blocks in address order, by their sentinels.
+         * An input iterator, since * builds each block by value.
+         * Invalidated by anything that changes the heap.
+         */
+        class block_iterator {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef block                   value_type;
+                typedef std::ptrdiff_t          difference_type;
+                typedef void                    pointer;
+                typedef block                   reference;
+
+            private:
+                const BasicAllocator* heap;
+                sentinel_type         i;
+
+            public:
+                block_iterator (const BasicAllocator* heap, sentinel_type i) :
+                    heap (heap),
+                    i (i)
+                {}
+
+                friend bool operator == (const block_iterator& lhs, const block_iterator& rhs) {
+                    return (lhs.heap == rhs.heap) && (lhs.i == rhs.i);}
+
+                friend bool operator != (const block_iterator& lhs, const block_iterator& rhs) {
+                    return !(lhs == rhs);}
+
+                block operator * () const {
+                    sentinel_type v = heap->view(i);
+                    block b = {static_cast<std::size_t>(i), static_cast<std::size_t>(std::abs(v)), v < 0,
+                               &heap->arena[i + heap->SENTINEL_SIZE]};
+                    return b;}
+
+                block_iterator& operator ++ () {
+                    i += std::abs(heap->view(i)) + (2 * heap->SENTINEL_SIZE);
+                    return *this;}
+
+                block_iterator operator ++ (int) {
+                    block_iterator x = *this;
+                    ++*this;
+                    return x;}};
+
+        // -----------
+        // block_range
+        // -----------
+
+        // what blocks() returns, for a range-based for
+        struct block_range {
+            block_iterator b;
+            block_iterator e;
+
+            block_iterator begin () const {
+                return b;}
+
+            block_iterator end () const {
+                return e;}};
+
     public:
         // -----------
         // operator ==
         // -----------
 
-        friend bool operator == (const Allocator&, const Allocator&) {
-            return true;}                                              // this is correct
+        // each allocator owns its arena, so only an allocator can free what it allocated
+        friend bool operator == (const BasicAllocator& lhs, const BasicAllocator& rhs) {
+            return &lhs == &rhs;}
 
         // -----------
         // operator !=
         // -----------
 
-        friend bool operator != (const Allocator& lhs, const Allocator& rhs) {
+        friend bool operator != (const BasicAllocator& lhs, const BasicAllocator& rhs) {
             return !(lhs == rhs);}
 
-    private:
-        // ----
-        // data
-        // ----
-
-        char a[N];
-
         // -----
         // valid
         // -----
@@ -74,68 +537,639 @@ class Allocator {
          * O(1) in space
          * O(n) in time
          * Traverse sentinel nodes and check to make sure all have valid pairs
+         * and a payload of at least LINK_SIZE
+         * then make sure every free block is on the right free list
+         * and that the bitmaps mark exactly the non-empty lists
+         * an empty arena, e.g. a moved-from one, has nothing to walk
+         * Public so wrappers and tests can check a heap they can't see into.
          */
         bool valid () const {
-            int current_idx = 0;
-            int current_node = view(0), pair_node, pair_idx;
-            while (current_idx != N) {
-                pair_idx = current_idx + abs(current_node) + SENTINEL_SIZE;
+            if (arena.size() == 0)
+                return (free_fl == 0) && (partial_slabs == -1);
+            sentinel_type current_idx = 0;
+            sentinel_type current_node, pair_node, pair_idx;
+            sentinel_type free_blocks = 0;
+            while (current_idx != arena.size()) {
+                current_node = view(current_idx);
+                pair_idx = current_idx + std::abs(current_node) + SENTINEL_SIZE;
                 pair_node = view(pair_idx);
                 if (current_node != pair_node)
                     return false;
-                current_idx += abs(current_node) + 2 * SENTINEL_SIZE;
-                current_node = view(current_idx);
+                if (std::abs(current_node) < LINK_SIZE)
+                    return false;
+                if (current_node > 0)
+                    ++free_blocks;
+                current_idx += std::abs(current_node) + 2 * SENTINEL_SIZE;
             }
 
-            return true;}
+            sentinel_type linked = 0;
+            for (int c = 0; c < FREE_CLASSES; ++c) {
+                int f = c / SL_CLASSES;
+                if ((free_lists[c] != -1) != (((free_sl[f] >> (c % SL_CLASSES)) & 1) != 0))
+                    return false;
+                if ((free_sl[f] != 0) != (((free_fl >> f) & 1) != 0))
+                    return false;
+                sentinel_type prev = -1;
+                for (sentinel_type i = free_lists[c]; i != -1; i = next_free(i)) {
+                    if (view(i) <= 0 || size_class(view(i)) != c || prev_free(i) != prev)
+                        return false;
+                    if (++linked > free_blocks)
+                        return false;
+                    prev = i;
+                }
+            }
+
+            // slabs are at least SLAB_SPAN apart, so a longer list has a cycle
+            sentinel_type slabs = 0;
+            sentinel_type prev = -1;
+            for (sentinel_type s = partial_slabs; s != -1; s = next_free(s)) {
+                if (s < 0 || s >= arena.size() || s % SLAB_SPAN != 0 || ++slabs > (arena.size() + SLAB_SPAN - 1) / SLAB_SPAN)
+                    return false;
+                if (view(s) >= 0 || prev_free(s) != prev || no_free_slots(s))
+                    return false;
+                prev = s;
+            }
+
+            return linked == free_blocks;}
+
+    private:
+        // ----
+        // data
+        // ----
+
+        // aligned so the payload after the first sentinel, &arena[SENTINEL_SIZE],
+        // is GRID aligned
+        Arena arena;
+
+        // heads of the segregated free lists, -1 if empty
+        sentinel_type free_lists[FREE_CLASSES];
+
+        // bit f of free_fl is set if any list of first-level class f is
+        // non-empty, bit s of free_sl[f] if its list s is
+        std::uint64_t free_fl;
+        std::uint32_t free_sl[FL_CLASSES];
+
+        // chooses which free block to allocate from
+        Policy policy;
+
+        // head of the slabs with a free slot, -1 if none
+        sentinel_type partial_slabs;
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the size of free block i, counting it toward the current
+         * search's scan length.
+         */
+        sentinel_type examine (sentinel_type i) const {
+            this->examined();
+            return view(i);}
+
+        /**
+         * O(1) in space
+         * O(k) in time, k the length of the request's free list
+         * Ask Policy for a free block of at least bytes bytes and record how
+         * many it examined.
+         * Returns its index, -1 if nothing fits.
+         */
+        sentinel_type find (sentinel_type bytes) {
+            this->start_scan();
+            sentinel_type i = policy.find(*this, bytes);
+            this->end_scan();
+            return i;}
+
+        void count_allocation (size_type k = 1) {
+            this->allocated(k);}
+
+        void count_deallocation (size_type k = 1) {
+            this->deallocated(k);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Count a failed allocation and throw a bad_alloc exception.
+         */
+        void fail () {
+            this->failed();
+            throw std::bad_alloc();}
 
         /**
          * O(1) in space
          * O(1) in time
          * Returns the amount of free/used bytes at the given sentinel.
          */
-        int& view (int i) {
-            return *reinterpret_cast<int*>(&a[i]);}
+        sentinel_type& view (sentinel_type i) {
+            return *reinterpret_cast<sentinel_type*>(&arena[i]);}
 
-    public:
-        // ------------
-        // constructors
-        // ------------
+        // ---------
+        // free list
+        // ---------
 
         /**
          * O(1) in space
          * O(1) in time
-         * Throw a bad_alloc exception, if N is less than sizeof(T) + (2 * sizeof(int))
+         * Links of the free block whose left sentinel is at i, stored in its payload.
          */
-        Allocator () {
-            if (N < T_SIZE + (2 * SENTINEL_SIZE)) {
-                throw std::bad_alloc();
+        sentinel_type& prev_free (sentinel_type i) {
+            return view(i + SENTINEL_SIZE);}
+
+        sentinel_type& next_free (sentinel_type i) {
+            return view(i + 2 * SENTINEL_SIZE);}
+
+        const sentinel_type& prev_free (sentinel_type i) const {
+            return view(i + SENTINEL_SIZE);}
+
+        const sentinel_type& next_free (sentinel_type i) const {
+            return view(i + 2 * SENTINEL_SIZE);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the index of the lowest/highest set bit of x, which must
+         * not be 0.
+         */
+        static int lowest_bit (std::uint64_t x) {
+#if defined(__GNUC__)
+            return __builtin_ctzll(x);
+#else
+            int b = 0;
+            for (; (x & 1) == 0; x >>= 1)
+                ++b;
+            return b;
+#endif
+        }
+
+        static int highest_bit (std::uint64_t x) {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll(x);
+#else
+            int b = 0;
+            while (x >>= 1)
+                ++b;
+            return b;
+#endif
+        }
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the free list that holds blocks of the given size.
+         */
+        int size_class (sentinel_type bytes) const {
+            if (bytes < LINK_SIZE)
+                return 0;
+            int f = std::min(highest_bit(bytes / LINK_SIZE), FL_CLASSES - 1);
+            sentinel_type low = LINK_SIZE << f;
+            sentinel_type s = (bytes - low) / (low >> SL_BITS);
+            return f * SL_CLASSES + static_cast<int>(std::min<sentinel_type>(s, SL_CLASSES - 1));}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the smallest size free list c holds.
+         */
+        sentinel_type class_min (int c) const {
+            sentinel_type low = LINK_SIZE << (c / SL_CLASSES);
+            return low + (c % SL_CLASSES) * (low >> SL_BITS);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the first non-empty free list at or after c, -1 if none,
+         * from the bitmaps.
+         */
+        int next_class (int c) const {
+            if (c >= FREE_CLASSES)
+                return -1;
+            int f = c / SL_CLASSES;
+            std::uint32_t sl = free_sl[f] & (~0u << (c % SL_CLASSES));
+            if (sl == 0) {
+                std::uint64_t fl = free_fl & (~0ull << (f + 1));
+                if (fl == 0)
+                    return -1;
+                f = lowest_bit(fl);
+                sl = free_sl[f];
             }
+            return f * SL_CLASSES + lowest_bit(sl);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Push the free block at i onto the front of its free list.
+         */
+        void link (sentinel_type i) {
+            assert(view(i) >= LINK_SIZE);
+            int c = size_class(view(i));
+            sentinel_type& head = free_lists[c];
+            prev_free(i) = -1;
+            next_free(i) = head;
+            if (head != -1)
+                prev_free(head) = i;
+            head = i;
+            free_fl |= std::uint64_t(1) << (c / SL_CLASSES);
+            free_sl[c / SL_CLASSES] |= 1u << (c % SL_CLASSES);}
 
-            int block_size = N - (2 * SENTINEL_SIZE);
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Remove the free block at i from its free list.
+         * Must be called before the block's sentinels change.
+         */
+        void unlink (sentinel_type i) {
+            policy.unlinked(*this, i);
+            sentinel_type prev = prev_free(i);
+            sentinel_type next = next_free(i);
+            if (prev != -1)
+                next_free(prev) = next;
+            else {
+                int c = size_class(view(i));
+                free_lists[c] = next;
+                if (next == -1) {
+                    free_sl[c / SL_CLASSES] &= ~(1u << (c % SL_CLASSES));
+                    if (free_sl[c / SL_CLASSES] == 0)
+                        free_fl &= ~(std::uint64_t(1) << (c / SL_CLASSES));
+                }
+            }
+            if (next != -1)
+                prev_free(next) = prev;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Round a payload up to at least LINK_SIZE, so the block can be
+         * linked once it is freed, and so the block after it starts on a
+         * GRID boundary.
+         */
+        sentinel_type round_payload (sentinel_type bytes) const {
+            bytes = std::max(bytes, LINK_SIZE);
+            return ((bytes + (2 * SENTINEL_SIZE) + GRID - 1) & ~(GRID - 1)) - (2 * SENTINEL_SIZE);}
+
+        /**
+         * O(1) in space
+         * O(k) in time, k the length of the request's free list
+         * Carve bytes bytes out of a free block chosen by Policy.
+         * Returns the index of the block's left sentinel, -1 if nothing fits.
+         */
+        sentinel_type carve (sentinel_type bytes) {
+            bytes = round_payload(bytes);
+            sentinel_type i = find(bytes);
+            if (i == -1)
+                return -1;
+            return carve_at(i, bytes);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Mark the free block at i as used, splitting off the remainder if
+         * it is big enough to hold another T and its links.
+         * bytes must already be rounded by round_payload.
+         * Returns i.
+         */
+        sentinel_type carve_at (sentinel_type i, sentinel_type bytes) {
+            sentinel_type valid_size = round_payload(T_SIZE) + (2 * SENTINEL_SIZE);
+            sentinel_type min_size = bytes + (2 * SENTINEL_SIZE);
+
+            sentinel_type val = view(i);
+            sentinel_type new_val, new_start, new_end, old_val, old_start, old_end;
+
+            new_start = i;
+            unlink(i);
+
+            // not enough space for another allocation, so
+            // allocate the whole block
+            if (val < min_size + valid_size) {
+                new_val = val;
+                new_end = i + new_val + SENTINEL_SIZE;
+            }
+            else {
+                // only allocate as many bytes as requested
+                new_val = bytes;
+                new_end = i + new_val + SENTINEL_SIZE;
+
+                // create/update sentinel of remainder of block
+                old_val = val - (2 * SENTINEL_SIZE) - new_val;
+                old_start = new_end + SENTINEL_SIZE;
+                old_end = old_start + old_val + SENTINEL_SIZE;
+                view(old_start) = old_val;
+                view(old_end) = old_val;
+                link(old_start);
+            }
+
+            view(new_start) = -new_val;
+            view(new_end) = -new_val;
+            return new_start;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Split the free block at i in two at i + g, both halves free.
+         * The first half must have a positive payload.
+         */
+        void split_free (sentinel_type i, sentinel_type g) {
+            sentinel_type val = view(i);
+            unlink(i);
+            view(i) = g - (2 * SENTINEL_SIZE);
+            view(i + g - SENTINEL_SIZE) = g - (2 * SENTINEL_SIZE);
+            view(i + g) = val - g;
+            view(i + val + SENTINEL_SIZE) = val - g;
+            link(i);
+            link(i + g);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the index of the left sentinel of the used block at p.
+         * throw an invalid_argument exception, if the block is free
+         */
+        sentinel_type used_block (pointer p) const {
+            sentinel_type i = std::distance(arena.data(), reinterpret_cast<const char*>(p) - SENTINEL_SIZE);
+            if (view(i) > 0)
+                throw std::invalid_argument("block is free");
+            return i;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Free the used blocks from the left sentinel at first up to, not
+         * including, the sentinel at end as one block, coalesced with its
+         * free neighbors and linked.
+         */
+        void release (sentinel_type first, sentinel_type end) {
+            if (first != 0 && view(first - SENTINEL_SIZE) > 0) {
+                first -= view(first - SENTINEL_SIZE) + (2 * SENTINEL_SIZE);
+                unlink(first);
+            }
+            if (end != arena.size() && view(end) > 0) {
+                sentinel_type right = end;
+                end += view(right) + (2 * SENTINEL_SIZE);
+                unlink(right);
+            }
+            sentinel_type val = end - first - (2 * SENTINEL_SIZE);
+            view(first) = val;
+            view(end - SENTINEL_SIZE) = val;
+            link(first);}
+
+        // ----
+        // slab
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * The free-slot bitmap of the slab at s, and how many slots it has.
+         */
+        std::uint32_t* slab_map (sentinel_type s) {
+            return reinterpret_cast<std::uint32_t*>(&arena[s + SENTINEL_SIZE + LINK_SIZE]);}
+
+        const std::uint32_t* slab_map (sentinel_type s) const {
+            return reinterpret_cast<const std::uint32_t*>(&arena[s + SENTINEL_SIZE + LINK_SIZE]);}
+
+        int slab_slots (sentinel_type s) const {
+            return static_cast<int>(std::min(static_cast<sentinel_type>(SLAB_CAPACITY), (-view(s) - SLAB_HEADER) / SLOT_SIZE));}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the bits of word w of the bitmap of a slab of n slots.
+         */
+        static std::uint32_t slab_mask (int n, int w) {
+            n -= 32 * w;
+            return (n >= 32) ? ~0u : (n <= 0) ? 0u : (1u << n) - 1;}
+
+        /**
+         * O(1) in space
+         * O(SLAB_SLOTS) in time, one word per 32 slots
+         * Whether none/all of the slots of the slab at s are free.
+         */
+        bool no_free_slots (sentinel_type s) const {
+            const std::uint32_t* map = slab_map(s);
+            for (int w = 0; w != SLAB_WORDS; ++w)
+                if (map[w] != 0)
+                    return false;
+            return true;}
+
+        bool all_slots_free (sentinel_type s) const {
+            const std::uint32_t* map = slab_map(s);
+            int n = slab_slots(s);
+            for (int w = 0; w != SLAB_WORDS; ++w)
+                if (map[w] != slab_mask(n, w))
+                    return false;
+            return true;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Push the slab at s onto/remove it from the slabs with a free slot.
+         */
+        void link_slab (sentinel_type s) {
+            prev_free(s) = -1;
+            next_free(s) = partial_slabs;
+            if (partial_slabs != -1)
+                prev_free(partial_slabs) = s;
+            partial_slabs = s;}
+
+        void unlink_slab (sentinel_type s) {
+            sentinel_type prev = prev_free(s);
+            sentinel_type next = next_free(s);
+            if (prev != -1)
+                next_free(prev) = next;
+            else
+                partial_slabs = next;
+            if (next != -1)
+                prev_free(next) = prev;}
+
+        /**
+         * O(1) in space
+         * O(k) in time, k as in allocate
+         * Carve a slab with a payload of bytes bytes, its left sentinel on a
+         * SLAB_SPAN boundary, with every slot free. The space skipped to get
+         * there is left behind as a free block, as in allocate_aligned.
+         * bytes must already be rounded by round_payload.
+         * Returns the index of its left sentinel, -1 if nothing fits.
+         */
+        sentinel_type carve_slab (sentinel_type bytes) {
+            // enough whatever the gap, else a block that may fit as it lies
+            sentinel_type i = find(bytes + SLAB_SPAN + (2 * SENTINEL_SIZE) + LINK_SIZE);
+            if (i == -1)
+                i = find(bytes);
+            if (i == -1)
+                return -1;
+
+            sentinel_type g = (SLAB_SPAN - (i % SLAB_SPAN)) % SLAB_SPAN;
+            while (g != 0 && g < (2 * SENTINEL_SIZE) + LINK_SIZE)
+                g += SLAB_SPAN;
+            if (view(i) < g + bytes)
+                return -1;
+            if (g != 0) {
+                split_free(i, g);
+                i += g;
+            }
+
+            i = carve_at(i, bytes);
+            std::uint32_t* map = slab_map(i);
+            int n = slab_slots(i);
+            for (int w = 0; w != SLAB_WORDS; ++w)
+                map[w] = slab_mask(n, w);
+            return i;}
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized over SLAB_SLOTS calls
+         * Take a free slot from the first slab that has one, carving a new
+         * slab of SLAB_CAPACITY slots out of the heap when none has. If a
+         * whole slab doesn't fit, a slab of one slot is tried.
+         * Returns the offset of the slot, -1 if the heap is full.
+         */
+        sentinel_type allocate_slot () {
+            if (partial_slabs == -1) {
+                sentinel_type s = carve_slab(SLAB_SPAN - (2 * SENTINEL_SIZE));
+                if (s == -1)
+                    s = carve_slab(round_payload(SLAB_HEADER + SLOT_SIZE));
+                if (s == -1)
+                    return -1;
+                link_slab(s);
+            }
+            sentinel_type s = partial_slabs;
+            std::uint32_t* map = slab_map(s);
+            int w = 0;
+            while (map[w] == 0)
+                ++w;
+            int b = lowest_bit(map[w]);
+            map[w] &= map[w] - 1;
+            if (no_free_slots(s))
+                unlink_slab(s);
+            return s + SENTINEL_SIZE + SLAB_HEADER + (32 * w + b) * SLOT_SIZE;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the slab of the slot at slot and the slot's index in it.
+         * throw an invalid_argument exception, if the slot is already free
+         */
+        sentinel_type used_slot (sentinel_type slot, int& k) const {
+            sentinel_type s = slot - (slot % SLAB_SPAN);
+            assert(view(s) < 0);
+            k = static_cast<int>((slot - s - SENTINEL_SIZE - SLAB_HEADER) / SLOT_SIZE);
+            if ((slab_map(s)[k / 32] >> (k % 32)) & 1)
+                throw std::invalid_argument("can't deallocate a slot that's already free");
+            return s;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Mark a slot free. A slab whose slots are all free goes back to the
+         * heap, coalesced with its free neighbors.
+         * throw an invalid_argument exception, if the slot is already free
+         */
+        void deallocate_slot (sentinel_type slot) {
+            int k;
+            sentinel_type s = used_slot(slot, k);
+            bool full = no_free_slots(s);
+            slab_map(s)[k / 32] |= 1u << (k % 32);
+            if (all_slots_free(s)) {
+                if (!full)
+                    unlink_slab(s);
+                release(s, s - view(s) + (2 * SENTINEL_SIZE));
+            }
+            else if (full)
+                link_slab(s);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Lay the whole arena out as one free block; an empty arena, e.g. a
+         * moved-from one, is left with empty lists.
+         */
+        void format () {
+            std::fill(free_lists, free_lists + FREE_CLASSES, -1);
+            std::fill(free_sl, free_sl + FL_CLASSES, 0);
+            free_fl = 0;
+            partial_slabs = -1;
+            policy = Policy();
+            if (arena.size() == 0)
+                return;
+
+            sentinel_type block_size = arena.size() - (2 * SENTINEL_SIZE);
             view(0) = block_size;
-            view(N - SENTINEL_SIZE) = block_size;
+            view(arena.size() - SENTINEL_SIZE) = block_size;
+            link(0);}
 
-            assert(valid());
-        }
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Align the arena and format it.
+         */
+        void init () {
+            arena.align(GRID, SENTINEL_SIZE);
+            if (arena.size() < std::max(T_SIZE, LINK_SIZE) + (2 * SENTINEL_SIZE)) {
+                throw std::bad_alloc();
+            }
 
+            format();
 
-        Allocator (const Allocator& other) :
-            a (other.a)
-        { assert(valid()); }
+            assert(valid());}
 
-        ~Allocator() {}
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Throw a bad_alloc exception, if the arena is smaller than max(sizeof(T), LINK_SIZE) + (2 * sizeof(sentinel_type))
+         * blocks are laid out on an ALIGN grid from the start of the arena,
+         * which is trimmed so that every payload is ALIGN aligned
+         */
+        BasicAllocator () {
+            init();}
+
+        explicit BasicAllocator (Arena storage) :
+            arena (std::move(storage)) {
+            init();}
 
-        Allocator& operator = (const Allocator& other) {
-            a = other.a;
-            assert(valid());
-            return *this;
-        }
 
         // Default copy, destructor, and copy assignment
-        // Allocator  (const Allocator&);
-        // ~Allocator ();
-        // Allocator& operator = (const Allocator&);
+        // the free list links are offsets into the arena, so they survive a
+        // copy; a move-only Arena, e.g. a BufferArena or MmapArena, makes the
+        // allocator move-only
+        BasicAllocator (const BasicAllocator&) = default;
+        // ~BasicAllocator ();
+        BasicAllocator& operator = (const BasicAllocator&) = default;
+
+        /**
+         * O(1) in space
+         * O(1) in time, plus the arena's move
+         * the moved-from allocator is formatted over whatever storage its
+         * arena is left with, so it is valid and empty, not pointing into
+         * the heap it gave away
+         */
+        BasicAllocator (BasicAllocator&& other) :
+            HeapCounters<STATS> (other),
+            arena               (std::move(other.arena)),
+            free_fl             (other.free_fl),
+            policy              (other.policy),
+            partial_slabs       (other.partial_slabs) {
+            std::copy(other.free_lists, other.free_lists + FREE_CLASSES, free_lists);
+            std::copy(other.free_sl, other.free_sl + FL_CLASSES, free_sl);
+            other.format();}
+
+        BasicAllocator& operator = (BasicAllocator&& other) {
+            if (this == &other)
+                return *this;
+            HeapCounters<STATS>::operator = (other);
+            arena = std::move(other.arena);
+            std::copy(other.free_lists, other.free_lists + FREE_CLASSES, free_lists);
+            std::copy(other.free_sl, other.free_sl + FL_CLASSES, free_sl);
+            free_fl       = other.free_fl;
+            policy        = other.policy;
+            partial_slabs = other.partial_slabs;
+            other.format();
+            return *this;}
 
         // --------
         // allocate
@@ -143,70 +1177,96 @@ class Allocator {
 
         /**
          * O(1) in space
-         * O(n) in time
+         * O(k) in time, k the length of the request's free list
          * after allocation there must be enough space left for a valid block
-         * the smallest allowable block is sizeof(T) + (2 * sizeof(int))
-         * choose the first block that fits
-         * return 0, if allocation fails
+         * the smallest allowable block is max(sizeof(T), LINK_SIZE) + (2 * sizeof(sentinel_type))
+         * the block is chosen by Policy, FirstFit by default
+         * if SLAB_SLOTS > 0, allocate(1) takes a headerless slab slot in O(1)
+         * throw a bad_alloc exception, if allocation fails
          */
         pointer allocate (size_type n) {
-            int valid_size = T_SIZE + (2 * SENTINEL_SIZE);
-            int min_size = (n * T_SIZE) + (2 * SENTINEL_SIZE);
+            sentinel_type min_size = (n * T_SIZE) + (2 * SENTINEL_SIZE);
 
             // check precondition
-            if (n <= 0 || n > N || min_size > N) {
-                throw std::bad_alloc();
+            if (n <= 0 || n > static_cast<size_type>(arena.size()) || min_size > arena.size()) {
+                fail();
             }
 
-            difference_type i = 0;
-            while (i < N) {
-                int& val = view(i);
+            if (SLAB_SLOTS > 0 && n == 1) {
+                sentinel_type slot = allocate_slot();
+                if (slot == -1)
+                    fail();
+                count_allocation();
+                assert(valid());
+                return reinterpret_cast<T*>(&arena[slot]);
+            }
 
-                // val is non-negative and big enough
-                if (val > 0 && val >= (signed) n) {
-                    int new_val, new_start, new_end, old_val, old_start, old_end;
+            sentinel_type i = carve(n * T_SIZE);
 
-                    new_start = i;
+            // not enough space
+            if (i == -1)
+                fail();
 
-                    // not enough space for another allocation, so
-                    // allocate the whole block
-                    if (val < min_size + valid_size) {
-                        new_val = val;
-                        new_end = i + new_val + SENTINEL_SIZE;
-                    }
-                    else {
-                        // only allocate as many bytes as requested
-                        new_val = n * T_SIZE;
-                        new_end = i + new_val + SENTINEL_SIZE;
-
-
-                        // create/update sentinel of remainder of block
-                        old_val = val - (2 * SENTINEL_SIZE) - new_val;
-                        old_start = new_end + SENTINEL_SIZE;
-                        old_end = old_start + old_val + SENTINEL_SIZE;
-                        view(old_start) = old_val;
-                        view(old_end) = old_val;
-                    }
+            count_allocation();
+            assert(valid());
 
-                    view(new_start) = -new_val;
-                    view(new_end) = -new_val;
+            return reinterpret_cast<T*>(&arena[i + SENTINEL_SIZE]);
+        }
 
-                    assert(valid());
+        /**
+         * O(1) in space
+         * O(k) in time, k the length of the request's free list
+         * allocate n objects at an address that is a multiple of align,
+         * which may be stricter than ALIGN, e.g. for vector loads
+         * the free space skipped to get there is left behind as a free block
+         * release with deallocate as usual
+         * if SLAB_SLOTS > 0, a single object can only be aligned to ALIGN,
+         * since deallocate(p, 1) returns it to a slab
+         * throw an invalid_argument exception, if align isn't a power of two,
+         * or if SLAB_SLOTS > 0, n is 1 and align is bigger than ALIGN
+         * throw a bad_alloc exception, if allocation fails
+         */
+        pointer allocate_aligned (size_type n, size_type align) {
+            if (align == 0 || (align & (align - 1)) != 0)
+                throw std::invalid_argument("alignment must be a power of two");
+            if (align <= ALIGN)
+                return allocate(n);
+            if (SLAB_SLOTS > 0 && n == 1)
+                throw std::invalid_argument("a slab slot can't be aligned beyond ALIGN");
 
-                    return reinterpret_cast<T*>(&a[new_start + SENTINEL_SIZE]);   
-                }
+            sentinel_type min_size = (n * T_SIZE) + (2 * SENTINEL_SIZE);
 
-                // either block is already occupied, or no space
-                // increment i to next block
-                i += abs(val) + (2 * SENTINEL_SIZE);
+            // check precondition
+            if (n <= 0 || n > static_cast<size_type>(arena.size()) || min_size > arena.size()) {
+                fail();
             }
-            assert(valid());
+
+            // enough for the payload plus the largest free block skipped in front
+            // of it, which is at most align bigger than its two sentinels and links
+            sentinel_type bytes = round_payload(n * T_SIZE);
+            sentinel_type i = find(bytes + align + (2 * SENTINEL_SIZE) + LINK_SIZE);
 
             // not enough space
-            if (i >= N)
-                throw std::bad_alloc();
+            if (i == -1)
+                fail();
+
+            // the skipped space needs room for two sentinels and the links,
+            // so it can go on a free list
+            std::uintptr_t payload = reinterpret_cast<std::uintptr_t>(&arena[i + SENTINEL_SIZE]);
+            sentinel_type g = (align - payload % align) % align;
+            while (g != 0 && g < (2 * SENTINEL_SIZE) + LINK_SIZE)
+                g += align;
+            if (g != 0) {
+                split_free(i, g);
+                i += g;
+            }
+
+            i = carve_at(i, bytes);
 
-            return 0;
+            count_allocation();
+            assert(valid());
+
+            return reinterpret_cast<T*>(&arena[i + SENTINEL_SIZE]);
         }
 
         // ---------
@@ -230,73 +1290,181 @@ class Allocator {
          * O(1) in space
          * O(1) in time
          * after deallocation adjacent free blocks must be coalesced
+         * coalesced neighbors are unlinked and the merged block relinked
+         * if SLAB_SLOTS > 0, deallocate(p, 1) returns the slot to its slab,
+         * and the slab to the heap once all its slots are free
          * Releases a block of storage previously allocated with member allocate
          * and not yet released.
+         * throw an invalid_argument exception, if the block or slot is already free
          */
-        void deallocate (pointer p, size_type) {
-            //get sentinel of block to be freed
-            char* block_start = reinterpret_cast<char*>(p);
+        void deallocate (pointer p, size_type n) {
+            if (SLAB_SLOTS > 0 && n == 1) {
+                deallocate_slot(std::distance(arena.data(), reinterpret_cast<char*>(p)));
+                count_deallocation();
+                assert(valid());
+                return;
+            }
 
-            //index of sentinel in heap array
-            int left_sent_idx = std::distance(a, block_start - SENTINEL_SIZE);
-            int* left_sent = &view(left_sent_idx);
+            // index of the block's left sentinel
+            sentinel_type i = std::distance(arena.data(), reinterpret_cast<char*>(p) - SENTINEL_SIZE);
 
-            //if block is already free, throw error
-            if (*left_sent > 0) {
+            // if block is already free, throw error
+            if (view(i) > 0) {
                 throw std::invalid_argument("can't deallocate a block that's already free");
             }
-            
-            //value to be written to new sentinels at end
-            int new_val = 0;
-            new_val += abs(*left_sent);
 
-            //get right sentinel
-            int right_sent_idx = left_sent_idx + SENTINEL_SIZE + new_val;
-            int* right_sent = &view(right_sent_idx);
+            // make sure you have the right sentinels
+            assert(view(i) == view(i - view(i) + SENTINEL_SIZE));
 
-            //make sure you have the right sentinels
-            assert(*left_sent == *right_sent);
+            release(i, i - view(i) + (2 * SENTINEL_SIZE));
 
-            //initialize new_start and new_end indices to be indices of left and right sents of current block
-            int new_start_idx = left_sent_idx;
-            int new_end_idx = right_sent_idx;
+            count_deallocation();
+            assert(valid());
+        }
 
+        // --------------
+        // allocate_batch
+        // --------------
 
-            //left is not at front of heap, so has block to left
-            if (left_sent_idx != 0) {
-                //get sentinel of neighbor to left
-                int* left_neighbor_sent = --left_sent;
+        /**
+         * O(1) in space
+         * O(k + count) in time, k as in allocate
+         * allocate count blocks of n objects each into out
+         * if one free block holds them all, they are carved from it back to
+         * back with a single search, otherwise one search per block
+         * if SLAB_SLOTS > 0, allocate_batch(count, 1, out) takes slab slots
+         * on failure nothing stays allocated
+         * throw a bad_alloc exception, if allocation fails
+         */
+        void allocate_batch (size_type count, size_type n, pointer* out) {
+            if (count == 0)
+                return;
+
+            sentinel_type min_size = (n * T_SIZE) + (2 * SENTINEL_SIZE);
+
+            // check precondition
+            if (n <= 0 || n > static_cast<size_type>(arena.size()) || min_size > arena.size()) {
+                fail();
+            }
 
-                //coalesce this block: keep track of new index (index of left neighbors' left sent)
-                //add freed space (plus 2 sents worth of space) to total val to write to new sents at end
-                if (*left_neighbor_sent > 0) {
-                    new_val += (*left_neighbor_sent) + (2 * SENTINEL_SIZE);
-                    new_start_idx -= ((*left_neighbor_sent) + (2 * SENTINEL_SIZE));
+            if (SLAB_SLOTS > 0 && n == 1) {
+                for (size_type k = 0; k != count; ++k) {
+                    sentinel_type slot = allocate_slot();
+                    if (slot == -1) {
+                        while (k != 0)
+                            deallocate_slot(std::distance(arena.data(), reinterpret_cast<char*>(out[--k])));
+                        fail();
+                    }
+                    out[k] = reinterpret_cast<T*>(&arena[slot]);
                 }
+                count_allocation(count);
+                assert(valid());
+                return;
             }
 
-            //right is not end of heap, so has block to right
-            //same thing as above
-            if (right_sent_idx != (N - SENTINEL_SIZE)) {
-                int* right_neighbor_sent = ++right_sent;
-                //coalesce
-                if (*right_neighbor_sent > 0) {
-                    new_val += ((*right_neighbor_sent) + (2 * SENTINEL_SIZE));
-                    new_end_idx += ((2 * SENTINEL_SIZE) + (*right_neighbor_sent));
+            sentinel_type bytes = round_payload(n * T_SIZE);
+            sentinel_type stride = bytes + (2 * SENTINEL_SIZE);
+            sentinel_type i = -1;
+            if (count <= static_cast<size_type>(arena.size() / stride))
+                i = find(count * stride - (2 * SENTINEL_SIZE));
+
+            if (i != -1) {
+                // lay out all but the last block, then carve the last from the rest
+                sentinel_type val = view(i);
+                unlink(i);
+                for (size_type k = 0; k != count - 1; ++k, i += stride) {
+                    view(i) = -bytes;
+                    view(i + bytes + SENTINEL_SIZE) = -bytes;
+                    out[k] = reinterpret_cast<T*>(&arena[i + SENTINEL_SIZE]);
+                }
+                val -= (count - 1) * stride;
+                view(i) = val;
+                view(i + val + SENTINEL_SIZE) = val;
+                link(i);
+                carve_at(i, bytes);
+                out[count - 1] = reinterpret_cast<T*>(&arena[i + SENTINEL_SIZE]);
+            }
+            else {
+                for (size_type k = 0; k != count; ++k) {
+                    i = carve(n * T_SIZE);
+                    if (i == -1) {
+                        while (k != 0) {
+                            sentinel_type j = used_block(out[--k]);
+                            release(j, j - view(j) + (2 * SENTINEL_SIZE));
+                        }
+                        fail();
+                    }
+                    out[k] = reinterpret_cast<T*>(&arena[i + SENTINEL_SIZE]);
                 }
             }
 
-            // make sure our new indices are in bounds
-            assert (left_sent_idx >= 0 && left_sent_idx <= (N - SENTINEL_SIZE));
-            assert (right_sent_idx >= 0 && right_sent_idx <= (N - SENTINEL_SIZE));
+            count_allocation(count);
+            assert(valid());}
 
-            // value of new sentinels to new_val
-            view(new_start_idx) = new_val;
-            view(new_end_idx) = new_val;
-      
+        // ----------------
+        // deallocate_batch
+        // ----------------
 
-            assert(valid());
-        }
+        /**
+         * O(1) in space
+         * O(count log count) in time
+         * deallocate count blocks of n objects each, as from allocate_batch
+         * p is sorted by address, and each run of blocks that are next to
+         * each other is freed and coalesced as one
+         * if SLAB_SLOTS > 0, deallocate_batch(p, count, 1) returns slab slots
+         * throw an invalid_argument exception, if a block or slot is free or
+         * appears twice; the heap is left unchanged
+         */
+        void deallocate_batch (pointer* p, size_type count, size_type n) {
+            const bool slots = (SLAB_SLOTS > 0 && n == 1);
+
+            std::sort(p, p + count);
+            for (size_type k = 0; k != count; ++k) {
+                if (slots) {
+                    int j;
+                    used_slot(std::distance(arena.data(), reinterpret_cast<char*>(p[k])), j);}
+                else
+                    used_block(p[k]);
+                if (k != 0 && p[k] == p[k - 1])
+                    throw std::invalid_argument("can't deallocate a block twice");
+            }
+
+            if (slots) {
+                for (size_type k = 0; k != count; ++k)
+                    deallocate_slot(std::distance(arena.data(), reinterpret_cast<char*>(p[k])));
+                count_deallocation(count);
+                assert(valid());
+                return;
+            }
+
+            size_type k = 0;
+            while (k != count) {
+                sentinel_type first = used_block(p[k]);
+                sentinel_type end = first - view(first) + (2 * SENTINEL_SIZE);
+                while (++k != count && reinterpret_cast<char*>(p[k]) == &arena[end + SENTINEL_SIZE])
+                    end += -view(end) + (2 * SENTINEL_SIZE);
+                release(first, end);
+            }
+
+            count_deallocation(count);
+            assert(valid());}
+
+        // -----
+        // reset
+        // -----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * free everything at once, slabs included, leaving the heap as
+         * constructed; every pointer it handed out is invalidated
+         * no destructors are run, so the objects must be trivially
+         * destructible or already destroyed
+         * the counters are kept
+         */
+        void reset () {
+            format();
+            assert(valid());}
 
         // -------
         // destroy
@@ -312,12 +1480,219 @@ class Allocator {
             p->~T();               // this is correct
             assert(valid());}
 
+        // -------------------
+        // try_expand_in_place
+        // -------------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * grow the block at p from old_n to new_n objects without moving it,
+         * by absorbing the free block to its right
+         * returns false, and changes nothing, if that isn't possible
+         * with SLAB_SLOTS > 0 a slab slot can't change size in place
+         * throw an invalid_argument exception, if p's block is free
+         */
+        bool try_expand_in_place (pointer p, size_type old_n, size_type new_n) {
+            if (new_n <= old_n)
+                return shrink_in_place(p, old_n, new_n);
+            if (SLAB_SLOTS > 0 && old_n == 1)
+                return false;
+
+            sentinel_type i = used_block(p);
+            sentinel_type val = -view(i);
+            sentinel_type bytes = round_payload(new_n * T_SIZE);
+
+            // the block may already have been handed out whole
+            if (bytes <= val)
+                return true;
+
+            sentinel_type right = i + val + (2 * SENTINEL_SIZE);
+            if (right == arena.size() || view(right) <= 0 || val + (2 * SENTINEL_SIZE) + view(right) < bytes)
+                return false;
+
+            // absorb the right neighbor; the block stays in use, so it is
+            // never linked, which would overwrite its first objects
+            sentinel_type total = val + (2 * SENTINEL_SIZE) + view(right);
+            unlink(right);
+
+            // split off the rest if it can hold a T and the links, as carve_at does
+            sentinel_type rest = total - bytes - (2 * SENTINEL_SIZE);
+            if (rest < round_payload(T_SIZE))
+                bytes = total;
+            view(i) = -bytes;
+            view(i + bytes + SENTINEL_SIZE) = -bytes;
+            if (bytes != total) {
+                sentinel_type j = i + bytes + (2 * SENTINEL_SIZE);
+                view(j) = rest;
+                view(j + rest + SENTINEL_SIZE) = rest;
+                link(j);
+            }
+
+            assert(valid());
+            return true;}
+
+        // ---------------
+        // shrink_in_place
+        // ---------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * shrink the block at p from old_n to new_n objects without moving it
+         * the freed tail is merged into the free block to its right, or
+         * becomes a free block of its own if it is big enough to hold a T
+         * and the free-list links
+         * objects past new_n must already be destroyed
+         * returns false if new_n > old_n, or if a slab slot is involved
+         * throw an invalid_argument exception, if p's block is free or new_n is 0
+         */
+        bool shrink_in_place (pointer p, size_type old_n, size_type new_n) {
+            if (new_n == 0)
+                throw std::invalid_argument("can't shrink a block to nothing, deallocate it");
+            if (new_n > old_n)
+                return false;
+            if (SLAB_SLOTS > 0 && (old_n == 1 || new_n == 1))
+                return new_n == old_n;
+
+            sentinel_type i = used_block(p);
+            sentinel_type val = -view(i);
+            sentinel_type bytes = round_payload(new_n * T_SIZE);
+            sentinel_type spare = val - bytes;
+            sentinel_type right = i + val + (2 * SENTINEL_SIZE);
+            sentinel_type tail = i + bytes + (2 * SENTINEL_SIZE);
+
+            if (spare > 0 && right != arena.size() && view(right) > 0) {
+                // slide the right neighbor's left sentinel down over the tail
+                sentinel_type total = spare + view(right);
+                unlink(right);
+                view(tail) = total;
+                view(tail + total + SENTINEL_SIZE) = total;
+            }
+            // round_payload(T_SIZE) is at least LINK_SIZE, so the tail can be linked
+            else if (spare >= (2 * SENTINEL_SIZE) + round_payload(T_SIZE)) {
+                sentinel_type total = spare - (2 * SENTINEL_SIZE);
+                view(tail) = total;
+                view(tail + total + SENTINEL_SIZE) = total;
+            }
+            else
+                return true;
+
+            view(i) = -bytes;
+            view(i + bytes + SENTINEL_SIZE) = -bytes;
+            link(tail);
+
+            assert(valid());
+            return true;}
+
+        // ----------
+        // reallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(k + n) in time, k as in allocate, n the objects moved
+         * resize the block at p from old_n to new_n objects, in place if the
+         * neighboring free space allows it, otherwise by allocating a new
+         * block, move constructing the first min(old_n, new_n) objects into
+         * it, destroying them in the old one and deallocating it
+         * the first min(old_n, new_n) objects must be constructed, and
+         * objects past new_n already destroyed; T's move must not throw
+         * returns the block's, possibly new, address
+         * throw a bad_alloc exception, if it has to move and allocation fails
+         */
+        pointer reallocate (pointer p, size_type old_n, size_type new_n) {
+            if (new_n <= old_n ? shrink_in_place(p, old_n, new_n) : try_expand_in_place(p, old_n, new_n))
+                return p;
+
+            pointer q = allocate(new_n);
+            size_type m = std::min(old_n, new_n);
+            for (size_type k = 0; k != m; ++k) {
+                new (q + k) T(std::move(p[k]));         // this is correct and exempt
+                p[k].~T();}                             // from the prohibition of new
+            deallocate(p, old_n);
+            return q;}
+
+        // ------
+        // blocks
+        // ------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * The heap's blocks in address order, e.g.
+         * for (auto b : x.blocks()) ...
+         */
+        block_range blocks () const {
+            block_range r = {block_iterator(this, 0), block_iterator(this, arena.size())};
+            return r;}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time, n the number of blocks
+         * Walk the heap for its live and free blocks and bytes and its largest
+         * free block, and add the counters if STATS is true.
+         */
+        AllocatorStats stats () const {
+            AllocatorStats s = this->counted();
+            for (block_iterator b = blocks().begin(); b != blocks().end(); ++b) {
+                block x = *b;
+                if (x.used) {
+                    ++s.live_blocks;
+                    s.live_bytes += x.bytes;}
+                else {
+                    ++s.free_blocks;
+                    s.free_bytes += x.bytes;
+                    s.largest_free = std::max(s.largest_free, x.bytes);}}
+            return s;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Zero the counters, e.g. after warming up.
+         */
+        void reset_stats () {
+            this->clear();}
+
         /**
          * O(1) in space
          * O(1) in time
          * Returns the amount of free/used bytes at the given sentinel.
          */
-        const int& view (int i) const {
-            return *reinterpret_cast<const int*>(&a[i]);}};
+        const sentinel_type& view (sentinel_type i) const {
+            return *reinterpret_cast<const sentinel_type*>(&arena[i]);}};
+
+// the sizes are bound to const references, e.g. by std::max, so they need definitions
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::SENTINEL_SIZE;
+
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::T_SIZE;
+
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::LINK_SIZE;
+
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::SLOT_SIZE;
+
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::SLAB_HEADER;
+
+template <typename T, typename Arena, typename Policy, int SLAB_SLOTS, std::size_t ALIGN, bool STATS>
+constexpr typename BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::sentinel_type BasicAllocator<T, Arena, Policy, SLAB_SLOTS, ALIGN, STATS>::SLAB_SPAN;
+
+// ---------
+// Allocator
+// ---------
+
+/**
+ * The fixed-size allocator: an N byte arena inside the object, int sentinels.
+ */
+template <typename T, int N, typename Policy = FirstFit, int SLAB_SLOTS = 0, std::size_t ALIGN = alignof(T), bool STATS = (ALLOCATOR_STATS != 0)>
+using Allocator = BasicAllocator<T, FixedArena<N, (ALIGN > sizeof(int)) ? ALIGN : sizeof(int)>, Policy, SLAB_SLOTS, ALIGN, STATS>;
 
 #endif // Allocator_h
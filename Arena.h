@@ -0,0 +1,219 @@
+// --------------------------
+// projects/allocator/Arena.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// --------------------------
+
+#ifndef Arena_h
+#define Arena_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>  // assert
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uintptr_t
+#include <new>      // bad_alloc
+#include <utility>  // move, swap
+
+#include <sys/mman.h> // madvise, mmap, munmap
+
+// ------
+// arenas
+// ------
+
+/**
+ * An arena is the storage a BasicAllocator lays its heap out in.
+ * sentinel_type is the type the heap's sentinels and offsets are stored as,
+ * MAX_SIZE a bound on size() the heap sizes its free-list index by,
+ * data() and size() the storage, and align(grid, s) trims it so that
+ * &data()[s] and size() are multiples of grid.
+ */
+
+// ----------
+// FixedArena
+// ----------
+
+/**
+ * N bytes inside the allocator object, with int sentinels.
+ * Placed GRID - sizeof(int) past a GRID boundary, so align is a no-op;
+ * size() is N rounded down to a multiple of GRID.
+ */
+template <int N, std::size_t GRID>
+class FixedArena {
+    public:
+        typedef int sentinel_type;
+
+        static constexpr sentinel_type MAX_SIZE = N;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        alignas(GRID) char pad[(GRID > sizeof(int)) ? GRID - sizeof(int) : GRID];
+        char a[N];
+
+    public:
+        char& operator [] (int i) {
+            return a[i];}
+
+        const char& operator [] (int i) const {
+            return a[i];}
+
+        char* data () {
+            return a;}
+
+        const char* data () const {
+            return a;}
+
+        int size () const {
+            return N - (N % GRID);}
+
+        void align (std::size_t grid, std::size_t s) const {
+            assert(reinterpret_cast<std::uintptr_t>(a + s) % grid == 0);}};
+
+// -----------
+// BufferArena
+// -----------
+
+/**
+ * A caller-owned buffer of any size, with 64-bit sentinels.
+ * The buffer must outlive the allocator. Move-only, so only one allocator
+ * ever lays its heap out in the buffer.
+ */
+class BufferArena {
+    public:
+        typedef std::int64_t sentinel_type;
+
+        static constexpr sentinel_type MAX_SIZE = INT64_MAX;
+
+    protected:
+        // ----
+        // data
+        // ----
+
+        char*         p;
+        sentinel_type n;
+
+    public:
+        BufferArena (void* buffer, std::size_t bytes) :
+            p (static_cast<char*>(buffer)),
+            n (bytes)
+        {}
+
+        // a moved-from arena is empty
+        BufferArena (BufferArena&& other) :
+            p (other.p),
+            n (other.n) {
+            other.p = 0;
+            other.n = 0;}
+
+        BufferArena& operator = (BufferArena&& other) {
+            std::swap(p, other.p);
+            std::swap(n, other.n);
+            return *this;}
+
+        BufferArena (const BufferArena&) = delete;
+        BufferArena& operator = (const BufferArena&) = delete;
+
+        char& operator [] (sentinel_type i) {
+            return p[i];}
+
+        const char& operator [] (sentinel_type i) const {
+            return p[i];}
+
+        char* data () {
+            return p;}
+
+        const char* data () const {
+            return p;}
+
+        sentinel_type size () const {
+            return n;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Skip up to grid - 1 bytes at the front and drop the back to a
+         * multiple of grid, so the last sentinel is aligned too; size()
+         * drops to 0 if the buffer is smaller than that.
+         */
+        void align (std::size_t grid, std::size_t s) {
+            std::size_t skip = (grid - (reinterpret_cast<std::uintptr_t>(p) + s) % grid) % grid;
+            if (static_cast<sentinel_type>(skip) > n)
+                skip = n;
+            p += skip;
+            n -= skip;
+            n -= n % grid;}};
+
+// ---------
+// MmapArena
+// ---------
+
+/**
+ * An anonymous private mapping of the given size, with 64-bit sentinels,
+ * unmapped on destruction. Move-only; moving from one empties it.
+ * With huge_pages, the mapping is first tried with MAP_HUGETLB, rounded up
+ * to 2 MB pages; if none are reserved, it falls back to normal pages and
+ * asks for transparent huge pages with madvise instead.
+ * Throw a bad_alloc exception, if the mapping fails
+ */
+class MmapArena : public BufferArena {
+    private:
+        // ----
+        // data
+        // ----
+
+        void*       map;
+        std::size_t map_size;
+
+        static const std::size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+    public:
+        explicit MmapArena (std::size_t bytes, bool huge_pages = false) :
+            BufferArena (0, bytes),
+            map (MAP_FAILED),
+            map_size (bytes) {
+#ifdef MAP_HUGETLB
+            if (huge_pages) {
+                map_size = (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+                map = mmap(0, map_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);}
+#endif
+            if (map == MAP_FAILED) {
+                map_size = bytes;
+                map = mmap(0, map_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (map == MAP_FAILED)
+                    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+                if (huge_pages)
+                    madvise(map, map_size, MADV_HUGEPAGE);
+#endif
+            }
+            p = static_cast<char*>(map);
+            n = map_size;}
+
+        MmapArena (MmapArena&& other) :
+            BufferArena (std::move(other)),
+            map (other.map),
+            map_size (other.map_size) {
+            other.map = MAP_FAILED;}
+
+        // swapped, so other unmaps what this held
+        MmapArena& operator = (MmapArena&& other) {
+            BufferArena::operator = (std::move(other));
+            std::swap(map, other.map);
+            std::swap(map_size, other.map_size);
+            return *this;}
+
+        MmapArena (const MmapArena&) = delete;
+        MmapArena& operator = (const MmapArena&) = delete;
+
+        ~MmapArena () {
+            if (map != MAP_FAILED)
+                munmap(map, map_size);}};
+
+#endif // Arena_h
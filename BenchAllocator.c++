@@ -0,0 +1,399 @@
+// -------------------------------------
+// projects/allocator/BenchAllocator.c++
+// Copyright (C) 2014
+// Glenn P. Downing
+// -------------------------------------
+
+// Usage: BenchAllocator [trace ...]
+//
+// Replays synthetic workloads, and any allocate/deallocate traces given on
+// the command line, against Allocator and std::allocator, and reports
+// ns/op percentiles, throughput, peak live bytes, peak arena footprint and
+// the worst external fragmentation, 1 - largest free block / free bytes,
+// seen during each workload. Throughput comes from a second replay on a
+// fresh allocator, timed as a whole with no per-operation clock reads.
+// Build with NDEBUG, or Allocator's assert(valid()) walks the whole heap on
+// every call, and with ALLOCATOR_STATS=0, so no counters are kept.
+//
+// A trace has one operation per line:
+//     a <id> <n>    allocate n objects as block id
+//     f <id>        deallocate block id
+// Blocks still live at the end of a trace are freed untimed.
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // max, sort
+#include <chrono>    // steady_clock
+#include <cstdio>    // printf
+#include <deque>     // deque
+#include <fstream>   // ifstream
+#include <map>       // map
+#include <memory>    // allocator, unique_ptr
+#include <new>       // bad_alloc
+#include <random>    // mt19937, uniform_int_distribution
+#include <string>    // string
+#include <vector>    // vector
+
+#include "Allocator.h"
+
+// --
+// Op
+// --
+
+struct Op {
+    bool allocate;
+    int  id;
+    int  n;};
+
+typedef std::vector<Op> Trace;
+
+// --------
+// Workload
+// --------
+
+struct Workload {
+    std::string name;
+    Trace       ops;
+    int         blocks;};   // number of distinct ids
+
+/**
+ * Builds synthetic traces. Sizes are in objects, 1 to max_n, and the objects
+ * live at any one time never exceed cap.
+ */
+class Generator {
+    private:
+        std::mt19937 rng;
+        int          max_n;
+        int          cap;
+        int          next_id;
+        int          live;
+        Trace        ops;
+
+        int size () {
+            return std::uniform_int_distribution<int>(1, max_n)(rng);}
+
+        int allocate (int n) {
+            ops.push_back(Op {true, next_id, n});
+            live += n;
+            return next_id++;}
+
+        void deallocate (int id, int n) {
+            ops.push_back(Op {false, id, n});
+            live -= n;}
+
+        Workload done (const char* name) {
+            Workload w = {name, ops, next_id};
+            ops.clear();
+            next_id = live = 0;
+            return w;}
+
+    public:
+        Generator (int max_n, int cap) :
+            rng (2014),
+            max_n (max_n),
+            cap (cap),
+            next_id (0),
+            live (0)
+        {}
+
+        // allocate a stack of blocks, free it top down, repeat
+        Workload lifo (int count) {
+            std::vector<std::pair<int, int> > stack;
+            while (next_id < count) {
+                int n;
+                while (live + (n = size()) <= cap && next_id < count)
+                    stack.push_back(std::make_pair(allocate(n), n));
+                while (!stack.empty()) {
+                    deallocate(stack.back().first, stack.back().second);
+                    stack.pop_back();}}
+            return done("lifo");}
+
+        // a queue of blocks: the oldest is freed once the next doesn't fit
+        Workload fifo (int count) {
+            std::deque<std::pair<int, int> > queue;
+            for (int i = 0; i < count; ++i) {
+                int n = size();
+                while (live + n > cap) {
+                    deallocate(queue.front().first, queue.front().second);
+                    queue.pop_front();}
+                queue.push_back(std::make_pair(allocate(n), n));}
+            while (!queue.empty()) {
+                deallocate(queue.front().first, queue.front().second);
+                queue.pop_front();}
+            return done("fifo");}
+
+        // random sizes, a random live block freed whenever the next doesn't fit
+        Workload churn (int count) {
+            std::vector<std::pair<int, int> > blocks;
+            for (int i = 0; i < count; ++i) {
+                int n = size();
+                while (live + n > cap || (!blocks.empty() && rng() % 3 == 0)) {
+                    int k = rng() % blocks.size();
+                    deallocate(blocks[k].first, blocks[k].second);
+                    blocks[k] = blocks.back();
+                    blocks.pop_back();}
+                blocks.push_back(std::make_pair(allocate(n), n));}
+            for (std::size_t k = 0; k != blocks.size(); ++k)
+                deallocate(blocks[k].first, blocks[k].second);
+            return done("churn");}
+
+        // a producer allocating messages in bursts and a consumer freeing
+        // them in order, in batches, with a lag; single threaded, since
+        // Allocator isn't thread-safe
+        Workload producer_consumer (int count) {
+            std::deque<std::pair<int, int> > queue;
+            int produced = 0;
+            while (produced < count) {
+                int burst = 1 + rng() % 64;
+                for (int i = 0; i < burst; ++i, ++produced) {
+                    int n = size();
+                    if (live + n > cap)
+                        break;
+                    queue.push_back(std::make_pair(allocate(n), n));}
+                int batch = std::min<int>(queue.size(), 1 + rng() % 48);
+                for (int i = 0; i < batch; ++i) {
+                    deallocate(queue.front().first, queue.front().second);
+                    queue.pop_front();}}
+            while (!queue.empty()) {
+                deallocate(queue.front().first, queue.front().second);
+                queue.pop_front();}
+            return done("prod/cons");}};
+
+/**
+ * Reads a trace file, renumbering ids densely.
+ * Returns false if it can't be read.
+ */
+bool read_trace (const char* path, Workload& w) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::map<int, std::pair<int, int> > ids;   // id -> (dense id, n)
+    char c;
+    int id, n;
+    w.name = path;
+    w.blocks = 0;
+    while (in >> c >> id) {
+        if (c == 'a') {
+            in >> n;
+            ids[id] = std::make_pair(w.blocks, n);
+            w.ops.push_back(Op {true, w.blocks++, n});}
+        else if (ids.count(id)) {
+            w.ops.push_back(Op {false, ids[id].first, ids[id].second});
+            ids.erase(id);}}
+    return true;}
+
+// -----
+// Probe
+// -----
+
+/**
+ * What the benchmark can see of an allocator's arena beyond its interface.
+ * Nothing, for std::allocator.
+ */
+template <typename A>
+struct Probe {
+    static bool arena () {
+        return false;}
+
+    static const char* base (const A&) {
+        return 0;}
+
+    static double fragmentation (const A&) {
+        return 0;}};
+
+/**
+ * A fixed arena's base and its heap walk.
+ */
+template <typename T, int N, std::size_t G, typename P, int S, std::size_t AL, bool ST>
+struct Probe<BasicAllocator<T, FixedArena<N, G>, P, S, AL, ST> > {
+    typedef BasicAllocator<T, FixedArena<N, G>, P, S, AL, ST> A;
+
+    static bool arena () {
+        return true;}
+
+    static const char* base (const A& a) {
+        return reinterpret_cast<const char*>(&a.view(0));}
+
+    static double fragmentation (const A& a) {
+        return a.stats().fragmentation();}};
+
+// ------
+// Result
+// ------
+
+struct Result {
+    long   ops;
+    long   failed;
+    double p50, p90, p99, p999, max;
+    double mops;
+    long   peak_live;
+    long   footprint;
+    double frag;};
+
+/**
+ * Replays w against a, timing every operation for the percentiles.
+ * Fragmentation is sampled, untimed, every SAMPLE operations; the worst
+ * sample is reported. The throughput is left to throughput().
+ */
+const int SAMPLE = 1024;
+
+template <typename A>
+Result run (A& a, const Workload& w) {
+    typedef typename A::pointer   pointer;
+    typedef typename A::value_type value_type;
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<pointer> blocks(w.blocks, pointer(0));
+    std::vector<int>     sizes(w.blocks, 0);
+    std::vector<long>    ns;
+    ns.reserve(w.ops.size());
+
+    Result r = Result();
+    long live = 0;
+    const char* base = Probe<A>::base(a);
+
+    for (std::size_t k = 0; k != w.ops.size(); ++k) {
+        const Op& op = w.ops[k];
+        if (Probe<A>::arena() && k % SAMPLE == 0 && live != 0)
+            r.frag = std::max(r.frag, Probe<A>::fragmentation(a));
+        clock::time_point t0 = clock::now();
+        if (op.allocate) {
+            try {
+                blocks[op.id] = a.allocate(op.n);}
+            catch (std::bad_alloc&) {
+                ++r.failed;
+                continue;}
+            ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count());
+            sizes[op.id] = op.n;
+            live += op.n * sizeof(value_type);
+            r.peak_live = std::max(r.peak_live, live);
+            if (base != 0)
+                r.footprint = std::max<long>(r.footprint,
+                    reinterpret_cast<const char*>(blocks[op.id] + op.n) - base);}
+        else if (blocks[op.id] != 0) {
+            a.deallocate(blocks[op.id], sizes[op.id]);
+            ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count());
+            blocks[op.id] = 0;
+            live -= sizes[op.id] * sizeof(value_type);}}
+
+    // whatever a trace left live is freed untimed
+    for (int id = 0; id != w.blocks; ++id)
+        if (blocks[id] != 0)
+            a.deallocate(blocks[id], sizes[id]);
+
+    std::sort(ns.begin(), ns.end());
+    r.ops = ns.size();
+    if (!ns.empty()) {
+        r.p50  = ns[ns.size() * 50 / 100];
+        r.p90  = ns[ns.size() * 90 / 100];
+        r.p99  = ns[ns.size() * 99 / 100];
+        r.p999 = ns[ns.size() * 999 / 1000];
+        r.max  = ns.back();}
+    return r;}
+
+/**
+ * Replays w against a with only the whole loop timed: no clock reads per
+ * operation and no sampling.
+ * Returns the operations done per microsecond, i.e. millions per second.
+ */
+template <typename A>
+double throughput (A& a, const Workload& w) {
+    typedef typename A::pointer   pointer;
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<pointer> blocks(w.blocks, pointer(0));
+    std::vector<int>     sizes(w.blocks, 0);
+    long ops = 0;
+
+    clock::time_point t0 = clock::now();
+    for (std::size_t k = 0; k != w.ops.size(); ++k) {
+        const Op& op = w.ops[k];
+        if (op.allocate) {
+            try {
+                blocks[op.id] = a.allocate(op.n);}
+            catch (std::bad_alloc&) {
+                continue;}
+            sizes[op.id] = op.n;
+            ++ops;}
+        else if (blocks[op.id] != 0) {
+            a.deallocate(blocks[op.id], sizes[op.id]);
+            blocks[op.id] = 0;
+            ++ops;}}
+    long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count();
+
+    for (int id = 0; id != w.blocks; ++id)
+        if (blocks[id] != 0)
+            a.deallocate(blocks[id], sizes[id]);
+
+    return (ns > 0) ? ops * 1e3 / ns : 0;}
+
+void header () {
+    std::printf("%-34s %-16s %9s %6s %7s %7s %7s %7s %9s %7s %10s %10s %6s\n",
+                "allocator", "workload", "ops", "failed",
+                "p50", "p90", "p99", "p99.9", "max", "Mops/s",
+                "peak live", "footprint", "frag");}
+
+/**
+ * Runs every workload against a fresh A, built on the heap since a fixed
+ * arena can be megabytes.
+ */
+template <typename A>
+void bench (const char* name, const std::vector<Workload>& ws) {
+    for (std::size_t k = 0; k != ws.size(); ++k) {
+        std::unique_ptr<A> a(new A());
+        Result r = run(*a, ws[k]);
+        std::unique_ptr<A> b(new A());
+        r.mops = throughput(*b, ws[k]);
+        std::printf("%-34s %-16s %9ld %6ld %7.0f %7.0f %7.0f %7.0f %9.0f %7.2f %10ld ",
+                    name, ws[k].name.c_str(), r.ops, r.failed,
+                    r.p50, r.p90, r.p99, r.p999, r.max, r.mops, r.peak_live);
+        if (Probe<A>::arena())
+            std::printf("%10ld %6.3f\n", r.footprint, r.frag);
+        else
+            std::printf("%10s %6s\n", "-", "-");}}
+
+std::vector<Workload> workloads (int max_n, int cap, int count, int argc, char** argv) {
+    Generator g(max_n, cap);
+    std::vector<Workload> ws;
+    ws.push_back(g.lifo(count));
+    ws.push_back(g.fifo(count));
+    ws.push_back(g.churn(count));
+    ws.push_back(g.producer_consumer(count));
+    for (int i = 1; i < argc; ++i) {
+        Workload w;
+        if (read_trace(argv[i], w))
+            ws.push_back(w);
+        else
+            std::fprintf(stderr, "can't read %s\n", argv[i]);}
+    return ws;}
+
+// ----
+// main
+// ----
+
+int main (int argc, char** argv) {
+    using namespace std;
+
+    // live objects kept well under the 64 KB arena
+    vector<Workload> small = workloads(64, 2000, 200000, argc, argv);
+
+    // live objects filling about a third of the 4 MB arenas
+    vector<Workload> large = workloads(256, 150000, 200000, argc, argv);
+
+    header();
+    bench<allocator<int> >                       ("std::allocator<int>",             small);
+    bench<Allocator<int, 1 << 16> >              ("Allocator<int, 64K>",             small);
+    bench<Allocator<double, 1 << 16> >           ("Allocator<double, 64K>",          small);
+    bench<Allocator<int, 1 << 16, FirstFit, 16> >("Allocator<int, 64K, slab 16>",    small);
+
+    bench<allocator<int> >                       ("std::allocator<int>",             large);
+    bench<allocator<double> >                    ("std::allocator<double>",          large);
+    bench<Allocator<int, 1 << 22> >              ("Allocator<int, 4M>",              large);
+    bench<Allocator<int, 1 << 22, NextFit> >     ("Allocator<int, 4M, NextFit>",     large);
+    bench<Allocator<int, 1 << 22, BestFit> >     ("Allocator<int, 4M, BestFit>",     large);
+    bench<Allocator<int, 1 << 22, GoodFit> >     ("Allocator<int, 4M, GoodFit>",     large);
+    bench<Allocator<int, 1 << 22, TwoLevelFit> > ("Allocator<int, 4M, TwoLevelFit>", large);
+    bench<Allocator<double, 1 << 22> >           ("Allocator<double, 4M>",           large);
+    return 0;}
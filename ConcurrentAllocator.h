@@ -0,0 +1,320 @@
+// ----------------------------------------
+// projects/allocator/ConcurrentAllocator.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// ----------------------------------------
+
+#ifndef ConcurrentAllocator_h
+#define ConcurrentAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>  // copy
+#include <atomic>     // atomic, atomic_flag
+#include <cstddef>    // ptrdiff_t, size_t
+#include <functional> // hash
+#include <mutex>      // mutex, lock_guard
+#include <new>        // bad_alloc, new
+#include <thread>     // this_thread
+
+#include "Allocator.h"
+
+// -------------------
+// ConcurrentAllocator
+// -------------------
+
+/**
+ * A thread-safe Allocator.
+ * Single objects are served from per-thread magazines of up to MAGAZINE
+ * blocks; the shared heap, behind one mutex, is only touched to refill or
+ * flush a magazine in batches and for allocate(n), n > 1.
+ * Threads are mapped onto CACHES magazines by thread id. A thread whose
+ * magazine is in use by another thread frees onto a lock-free return stack
+ * instead, which the next refill drains.
+ */
+template <typename T, int N, typename Policy = FirstFit, int MAGAZINE = 16, int CACHES = 8>
+class ConcurrentAllocator {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+    private:
+        // cached blocks hold the return stack's int link, so they're at least that big
+        const int CACHED_N = (sizeof(int) + sizeof(T) - 1) / sizeof(T);
+
+        // -----
+        // Cache
+        // -----
+
+        // a magazine on its own cache line, held by at most one thread at a time
+        struct alignas(64) Cache {
+            std::atomic_flag busy;
+            int              count;
+            pointer          rounds[MAGAZINE];};
+
+        // ----
+        // data
+        // ----
+
+        Allocator<T, N, Policy> heap;
+        std::mutex              heap_lock;
+
+        // head of the return stack, as an offset from &heap, -1 if empty
+        std::atomic<int>        returns;
+
+        Cache                   caches[CACHES];
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * The return stack link stored in a free cached block.
+         */
+        int& link (pointer p) {
+            return *reinterpret_cast<int*>(p);}
+
+        int offset (pointer p) const {
+            return reinterpret_cast<const char*>(p) - reinterpret_cast<const char*>(&heap);}
+
+        pointer at (int i) {
+            return reinterpret_cast<pointer>(reinterpret_cast<char*>(&heap) + i);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns this thread's cache, held, or 0 if another thread holds it.
+         */
+        Cache* acquire () {
+            Cache* c = &caches[std::hash<std::thread::id>()(std::this_thread::get_id()) % CACHES];
+            if (c->busy.test_and_set(std::memory_order_acquire))
+                return 0;
+            return c;}
+
+        void release (Cache* c) {
+            c->busy.clear(std::memory_order_release);}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Lock-free push onto the return stack.
+         */
+        void push_return (pointer p) {
+            int head = returns.load(std::memory_order_relaxed);
+            do {
+                link(p) = head;
+            } while (!returns.compare_exchange_weak(head, offset(p),
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed));}
+
+        /**
+         * O(1) in space
+         * O(MAGAZINE) in time
+         * Fill an empty magazine, from the return stack if anything is on it,
+         * otherwise with up to MAGAZINE / 2 fresh blocks from the heap.
+         * Returned blocks that don't fit go back to the heap in the same lock.
+         */
+        void refill (Cache* c) {
+            int head = returns.exchange(-1, std::memory_order_acquire);
+            while (head != -1 && c->count != MAGAZINE) {
+                c->rounds[c->count++] = at(head);
+                head = link(at(head));}
+            if (head == -1 && c->count != 0)
+                return;
+
+            std::lock_guard<std::mutex> guard(heap_lock);
+            while (head != -1) {
+                pointer p = at(head);
+                head = link(p);
+                heap.deallocate(p, CACHED_N);}
+            try {
+                while (c->count < MAGAZINE / 2) {
+                    pointer p = heap.allocate(CACHED_N);
+                    c->rounds[c->count++] = p;}}
+            catch (std::bad_alloc&)
+                {}}
+
+        /**
+         * O(1) in space
+         * O(MAGAZINE) in time
+         * Hand the older half of a full magazine back to the heap.
+         */
+        void flush_half (Cache* c) {
+            std::lock_guard<std::mutex> guard(heap_lock);
+            int keep = MAGAZINE / 2;
+            for (int i = 0; i < c->count - keep; ++i)
+                heap.deallocate(c->rounds[i], CACHED_N);
+            std::copy(c->rounds + c->count - keep, c->rounds + c->count, c->rounds);
+            c->count = keep;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Throw a bad_alloc exception, if the underlying Allocator does
+         */
+        ConcurrentAllocator () :
+            returns (-1) {
+            for (int i = 0; i < CACHES; ++i) {
+                caches[i].busy.clear();
+                caches[i].count = 0;}}
+
+        // the caches and the lock aren't copyable
+        ConcurrentAllocator (const ConcurrentAllocator&) = delete;
+        ConcurrentAllocator& operator = (const ConcurrentAllocator&) = delete;
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized, for n == 1
+         * allocate(n), n > 1, locks the heap
+         * if the heap is full, everything cached is flushed and it's tried again
+         * a request that could never fit fails without flushing
+         * throw a bad_alloc exception, if allocation fails
+         */
+        pointer allocate (size_type n) {
+            // check precondition
+            if (n == 0 || n > (N - (2 * sizeof(int))) / sizeof(T))
+                throw std::bad_alloc();
+
+            if (n == 1) {
+                if (Cache* c = acquire()) {
+                    if (c->count == 0)
+                        refill(c);
+                    pointer p = (c->count != 0) ? c->rounds[--c->count] : 0;
+                    release(c);
+                    if (p != 0)
+                        return p;}
+                n = CACHED_N;}
+            try {
+                std::lock_guard<std::mutex> guard(heap_lock);
+                return heap.allocate(n);}
+            catch (std::bad_alloc&) {
+                flush();
+                std::lock_guard<std::mutex> guard(heap_lock);
+                return heap.allocate(n);}}
+
+        // ---------
+        // construct
+        // ---------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Constructs a copy of v at p.
+         */
+        void construct (pointer p, const_reference v) {
+            new (p) T(v);}                              // this is correct and exempt
+                                                        // from the prohibition of new
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time, amortized, for n == 1
+         * deallocate(p, n), n > 1, locks the heap
+         * a single object goes into this thread's magazine, or onto the
+         * return stack if another thread holds it
+         */
+        void deallocate (pointer p, size_type n) {
+            if (n == 1) {
+                if (Cache* c = acquire()) {
+                    if (c->count == MAGAZINE)
+                        flush_half(c);
+                    c->rounds[c->count++] = p;
+                    release(c);}
+                else
+                    push_return(p);
+                return;}
+            std::lock_guard<std::mutex> guard(heap_lock);
+            heap.deallocate(p, n);}
+
+        // -------
+        // destroy
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Destroys in-place the object pointed by p.
+         */
+        void destroy (pointer p) {
+            p->~T();}                                   // this is correct
+
+        // -----
+        // flush
+        // -----
+
+        /**
+         * O(1) in space
+         * O(CACHES * MAGAZINE + r) in time, r the length of the return stack
+         * Hand every cached and returned block back to the heap, e.g. before
+         * a large allocation or once all worker threads have joined.
+         */
+        void flush () {
+            for (int i = 0; i < CACHES; ++i) {
+                Cache* c = &caches[i];
+                while (c->busy.test_and_set(std::memory_order_acquire))
+                    std::this_thread::yield();
+                std::lock_guard<std::mutex> guard(heap_lock);
+                while (c->count != 0)
+                    heap.deallocate(c->rounds[--c->count], CACHED_N);
+                release(c);}
+
+            int head = returns.exchange(-1, std::memory_order_acquire);
+            std::lock_guard<std::mutex> guard(heap_lock);
+            while (head != -1) {
+                pointer p = at(head);
+                head = link(p);
+                heap.deallocate(p, CACHED_N);}}
+
+        // -----
+        // valid
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * Check the shared heap's sentinels and free lists.
+         */
+        bool valid () {
+            std::lock_guard<std::mutex> guard(heap_lock);
+            return heap.valid();}
+
+        // -----
+        // stats
+        // -----
+
+        /**
+         * O(1) in space
+         * O(n) in time
+         * The shared heap's stats. Cached and returned blocks count as live,
+         * and the counters count the heap's traffic, refills and flushes
+         * included, not the callers'; flush() first for an exact picture.
+         */
+        AllocatorStats stats () {
+            std::lock_guard<std::mutex> guard(heap_lock);
+            return heap.stats();}};
+
+#endif // ConcurrentAllocator_h
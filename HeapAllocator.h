@@ -0,0 +1,146 @@
+// ----------------------------------
+// projects/allocator/HeapAllocator.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// ----------------------------------
+
+#ifndef HeapAllocator_h
+#define HeapAllocator_h
+
+// --------
+// includes
+// --------
+
+#include <cstddef>     // max_align_t, ptrdiff_t, size_t
+#include <type_traits> // true_type
+
+#include "Allocator.h"
+
+// --------
+// ByteHeap
+// --------
+
+/**
+ * A heap shared by HeapAllocators of any element type: sizes are in bytes
+ * and every block is aligned for any fundamental type.
+ */
+template <typename Arena, typename Policy = FirstFit>
+using ByteHeap = BasicAllocator<char, Arena, Policy, 0, alignof(std::max_align_t)>;
+
+// -------------
+// HeapAllocator
+// -------------
+
+/**
+ * A standard-library allocator that is a handle to a shared Heap, such as a
+ * ByteHeap, rather than an arena of its own. Copying a handle is cheap,
+ * it rebinds to any element type, e.g. a container's nodes, and two handles
+ * are equal exactly when they share a heap, so containers built from one
+ * heap allocate out of the same arena and can swap and splice freely.
+ * The heap must outlive every handle to it and everything they allocated.
+ */
+template <typename T, typename Heap = ByteHeap<MmapArena> >
+class HeapAllocator {
+    // handles of other element types share the heap
+    template <typename U, typename H>
+    friend class HeapAllocator;
+
+    template <typename U, typename V, typename H>
+    friend bool operator == (const HeapAllocator<U, H>&, const HeapAllocator<V, H>&);
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                 value_type;
+
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+
+        typedef       value_type*       pointer;
+        typedef const value_type* const_pointer;
+
+        typedef       value_type&       reference;
+        typedef const value_type& const_reference;
+
+        // the heap follows the container's contents around
+        typedef std::true_type    propagate_on_container_copy_assignment;
+        typedef std::true_type    propagate_on_container_move_assignment;
+        typedef std::true_type    propagate_on_container_swap;
+
+        template <typename U>
+        struct rebind {
+            typedef HeapAllocator<U, Heap> other;};
+
+    private:
+        // ----
+        // data
+        // ----
+
+        Heap* heap;
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        explicit HeapAllocator (Heap& heap) noexcept :
+            heap (&heap)
+        {}
+
+        template <typename U>
+        HeapAllocator (const HeapAllocator<U, Heap>& other) noexcept :
+            heap (other.heap)
+        {}
+
+        // Default copy, destructor, and copy assignment
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(k) in time, as the heap's allocate
+         * n objects aligned for T out of the shared heap, 0 if n is 0
+         * throw a bad_alloc exception, if allocation fails
+         */
+        pointer allocate (size_type n) {
+            if (n == 0)
+                return 0;
+            return reinterpret_cast<pointer>(heap->allocate_aligned(n * sizeof(T), alignof(T)));}
+
+        // ----------
+        // deallocate
+        // ----------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Returns the block to the shared heap, where it is coalesced.
+         */
+        void deallocate (pointer p, size_type n) {
+            if (p != 0)
+                heap->deallocate(reinterpret_cast<char*>(p), n * sizeof(T));}};
+
+// -----------
+// operator ==
+// -----------
+
+/**
+ * Handles are equal, even across element types, when they share a heap.
+ */
+template <typename T, typename U, typename Heap>
+bool operator == (const HeapAllocator<T, Heap>& lhs, const HeapAllocator<U, Heap>& rhs) {
+    return lhs.heap == rhs.heap;}
+
+// -----------
+// operator !=
+// -----------
+
+template <typename T, typename U, typename Heap>
+bool operator != (const HeapAllocator<T, Heap>& lhs, const HeapAllocator<U, Heap>& rhs) {
+    return !(lhs == rhs);}
+
+#endif // HeapAllocator_h
@@ -0,0 +1,150 @@
+// --------------------------
+// projects/allocator/Scope.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// --------------------------
+
+#ifndef Scope_h
+#define Scope_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>  // assert
+#include <cstddef>  // size_t
+#include <cstdint>  // uintptr_t
+#include <new>      // bad_alloc
+
+#include "Allocator.h"
+
+// -----
+// Scope
+// -----
+
+/**
+ * A checkpointed region for short-lived objects, e.g. one request's.
+ * It carves one block out of a Heap, such as an Allocator or a ByteHeap,
+ * and bump allocates from it with no per-object headers. mark() records
+ * how much is in use, release(m) frees everything allocated since mark m,
+ * and the block goes back to the heap, in one deallocate, when the Scope
+ * is destroyed.
+ * No destructors are run, so the objects must be trivially destructible
+ * or already destroyed. Scopes can't be copied.
+ */
+template <typename Heap>
+class Scope {
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef std::size_t size_type;
+
+        // how much of the region is in use, from mark()
+        typedef std::size_t mark_type;
+
+    private:
+        typedef typename Heap::value_type value_type;
+        typedef typename Heap::pointer    pointer;
+
+        // ----
+        // data
+        // ----
+
+        Heap&     heap;
+        size_type n;         // objects of the heap's value_type in the block
+        pointer   block;
+        char*     base;
+        size_type top;       // bytes in use
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * O(1) in space
+         * O(k) in time, k as in the heap's allocate
+         * A region of at least bytes bytes.
+         * Throw a bad_alloc exception, if the heap does
+         */
+        Scope (Heap& heap, size_type bytes) :
+            heap  (heap),
+            n     ((bytes + sizeof(value_type) - 1) / sizeof(value_type)),
+            block (heap.allocate(n)),
+            base  (reinterpret_cast<char*>(block)),
+            top   (0)
+        {}
+
+        Scope (const Scope&) = delete;
+        Scope& operator = (const Scope&) = delete;
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Give the block back to the heap.
+         */
+        ~Scope () {
+            heap.deallocate(block, n);}
+
+        // --------
+        // allocate
+        // --------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * k uninitialized Us, aligned for U, from the rest of the region.
+         * throw a bad_alloc exception, if they don't fit
+         */
+        template <typename U>
+        U* allocate (size_type k = 1) {
+            std::uintptr_t a = reinterpret_cast<std::uintptr_t>(base + top);
+            size_type skip = (alignof(U) - a % alignof(U)) % alignof(U);
+            if (skip > capacity() - top || k > (capacity() - top - skip) / sizeof(U))
+                throw std::bad_alloc();
+            U* p = reinterpret_cast<U*>(base + top + skip);
+            top += skip + k * sizeof(U);
+            return p;}
+
+        // ----
+        // mark
+        // ----
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         */
+        mark_type mark () const {
+            return top;}
+
+        // -------
+        // release
+        // -------
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Free everything allocated since m, which must be from mark() and
+         * not already released past.
+         */
+        void release (mark_type m) {
+            assert(m <= top);
+            top = m;}
+
+        /**
+         * O(1) in space
+         * O(1) in time
+         * Free everything.
+         */
+        void reset () {
+            top = 0;}
+
+        size_type used () const {
+            return top;}
+
+        size_type capacity () const {
+            return n * sizeof(value_type);}};
+
+#endif // Scope_h
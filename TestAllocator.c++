@@ -8,12 +8,24 @@
 // includes
 // --------
 
-#include <algorithm> // count
+#include <algorithm> // count, sort, unique
+#include <atomic>    // atomic
+#include <cstdint>   // uintptr_t
+#include <list>      // list
+#include <map>       // map
 #include <memory>    // allocator
+#include <mutex>     // mutex, lock_guard
+#include <random>    // mt19937
+#include <thread>    // thread
+#include <type_traits> // is_copy_assignable
+#include <vector>    // vector
 
 #include "gtest/gtest.h"
 
 #include "Allocator.h"
+#include "ConcurrentAllocator.h"
+#include "HeapAllocator.h"
+#include "Scope.h"
 
 // -------------
 // TestAllocator
@@ -34,7 +46,19 @@ typedef testing::Types<
             std::allocator<int>,
             std::allocator<double>,
             Allocator<int, 100>,
-            Allocator<double, 100> >
+            Allocator<double, 100>,
+            Allocator<int, 100, NextFit>,
+            Allocator<double, 100, NextFit>,
+            Allocator<int, 100, BestFit>,
+            Allocator<double, 100, BestFit>,
+            Allocator<int, 100, GoodFit>,
+            Allocator<double, 100, GoodFit>,
+            Allocator<int, 100, TwoLevelFit>,
+            Allocator<double, 100, TwoLevelFit>,
+            Allocator<int, 100, FirstFit, 4>,
+            Allocator<double, 200, FirstFit, 4>,
+            ConcurrentAllocator<int, 100>,
+            ConcurrentAllocator<double, 100> >
         my_types;
 
 TYPED_TEST_CASE(TestAllocator, my_types);
@@ -390,7 +414,7 @@ TEST(TestMyAllocator, deallocate_first_char) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(0), 1);
+    ASSERT_EQ(xr.view(0), 8);
 }
 
 TEST(TestMyAllocator, deallocate_first_double) {
@@ -420,7 +444,7 @@ TEST(TestMyAllocator, deallocate_first_int) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(0), 4);
+    ASSERT_EQ(xr.view(0), 8);
 }
 
 TEST(TestMyAllocator, deallocate_first_long) {
@@ -451,7 +475,7 @@ TEST(TestMyAllocator, deallocate_last_char) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(96), 83);
+    ASSERT_EQ(xr.view(96), 76);
 }
 
 TEST(TestMyAllocator, deallocate_last_double) {
@@ -466,7 +490,8 @@ TEST(TestMyAllocator, deallocate_last_double) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(96), 76);
+    // the arena is 96 bytes, a multiple of 8, so the last sentinel is aligned
+    ASSERT_EQ(xr.view(92), 72);
 }
 
 TEST(TestMyAllocator, deallocate_last_int) {
@@ -481,7 +506,7 @@ TEST(TestMyAllocator, deallocate_last_int) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(96), 80);
+    ASSERT_EQ(xr.view(96), 76);
 }
 
 TEST(TestMyAllocator, deallocate_last_long) {
@@ -496,5 +521,1208 @@ TEST(TestMyAllocator, deallocate_last_long) {
         caught = true;
     }
     ASSERT_FALSE(caught);
-    ASSERT_EQ(xr.view(96), 76);
+    // the arena is 96 bytes, a multiple of 8, so the last sentinel is aligned
+    ASSERT_EQ(xr.view(92), 72);
+}
+
+// free lists
+TEST(TestMyAllocator, free_list_reuse_int) {
+    Allocator<int, 100> x;
+    Allocator<int, 100>::pointer p1 = x.allocate(2);
+    Allocator<int, 100>::pointer p2 = x.allocate(2);
+    Allocator<int, 100>::pointer p3 = x.allocate(2);
+    x.deallocate(p2, 2);
+    ASSERT_EQ(p2, x.allocate(2));
+    x.deallocate(p1, 2);
+    x.deallocate(p3, 2);
+}
+
+TEST(TestMyAllocator, free_list_reuse_single_int) {
+    // every other single int freed, with no free neighbor to coalesce with
+    Allocator<int, 1000> x;
+    std::vector<Allocator<int, 1000>::pointer> p;
+    try {
+        while (true)
+            p.push_back(x.allocate(1));}
+    catch (std::bad_alloc& e) {}
+    ASSERT_EQ(p.size(), 62u);
+    std::vector<Allocator<int, 1000>::pointer> q;
+    for (std::size_t i = 0; i < p.size(); i += 2) {
+        x.deallocate(p[i], 1);
+        q.push_back(p[i]);}
+    std::vector<Allocator<int, 1000>::pointer> r;
+    for (std::size_t i = 0; i < q.size(); ++i)
+        r.push_back(x.allocate(1));
+    std::sort(r.begin(), r.end());
+    ASSERT_TRUE(q == r);
+    for (std::size_t i = 0; i < p.size(); ++i)
+        x.deallocate(p[i], 1);
+    ASSERT_EQ(x.stats().free_blocks, 1u);
+}
+
+TEST(TestMyAllocator, free_list_coalesce_int) {
+    Allocator<int, 1000> x;
+    const Allocator<int, 1000>& xr = x;
+    Allocator<int, 1000>::pointer p[10];
+    for (int i = 0; i < 10; ++i)
+        p[i] = x.allocate(i + 1);
+    for (int i = 0; i < 10; i += 2)
+        x.deallocate(p[i], i + 1);
+    for (int i = 9; i > 0; i -= 2)
+        x.deallocate(p[i], i + 1);
+    ASSERT_EQ(xr.view(0), 992);
+}
+
+TEST(TestMyAllocator, free_list_bigger_class_double) {
+    Allocator<double, 1000> x;
+    Allocator<double, 1000>::pointer p1 = x.allocate(1);
+    Allocator<double, 1000>::pointer p2 = x.allocate(20);
+    Allocator<double, 1000>::pointer p3 = x.allocate(1);
+    x.deallocate(p2, 20);
+    ASSERT_EQ(p2, x.allocate(10));
+    x.deallocate(p1, 1);
+    x.deallocate(p3, 1);
+}
+
+// placement policies
+TEST(TestMyAllocator, first_fit_int) {
+    Allocator<int, 1000, FirstFit> x;
+    Allocator<int, 1000, FirstFit>::pointer p1 = x.allocate(33);
+    Allocator<int, 1000, FirstFit>::pointer p2 = x.allocate(1);
+    Allocator<int, 1000, FirstFit>::pointer p3 = x.allocate(35);
+    Allocator<int, 1000, FirstFit>::pointer p4 = x.allocate(1);
+    x.deallocate(p1, 33);
+    x.deallocate(p3, 35);
+    ASSERT_EQ(p3, x.allocate(33));
+    x.deallocate(p2, 1);
+    x.deallocate(p4, 1);
+}
+
+TEST(TestMyAllocator, next_fit_int) {
+    Allocator<int, 1000, NextFit> x;
+    Allocator<int, 1000, NextFit>::pointer p[6];
+    for (int i = 0; i < 6; ++i)
+        p[i] = x.allocate(9);
+    x.deallocate(p[0], 9);
+    x.deallocate(p[2], 9);
+    x.deallocate(p[4], 9);
+    ASSERT_EQ(p[4], x.allocate(9));
+    x.deallocate(p[4], 9);
+    ASSERT_EQ(p[2], x.allocate(9));
+}
+
+TEST(TestMyAllocator, best_fit_int) {
+    Allocator<int, 1000, BestFit> x;
+    Allocator<int, 1000, BestFit>::pointer p1 = x.allocate(33);
+    Allocator<int, 1000, BestFit>::pointer p2 = x.allocate(1);
+    Allocator<int, 1000, BestFit>::pointer p3 = x.allocate(35);
+    Allocator<int, 1000, BestFit>::pointer p4 = x.allocate(1);
+    x.deallocate(p1, 33);
+    x.deallocate(p3, 35);
+    ASSERT_EQ(p1, x.allocate(33));
+    x.deallocate(p2, 1);
+    x.deallocate(p4, 1);
+}
+
+TEST(TestMyAllocator, good_fit_int) {
+    Allocator<int, 1000, GoodFit> x;
+    Allocator<int, 1000, GoodFit>::pointer p1 = x.allocate(35);
+    Allocator<int, 1000, GoodFit>::pointer p2 = x.allocate(1);
+    Allocator<int, 1000, GoodFit>::pointer p3 = x.allocate(40);
+    Allocator<int, 1000, GoodFit>::pointer p4 = x.allocate(100);
+    x.deallocate(p1, 35);
+    x.deallocate(p3, 40);
+    ASSERT_EQ(p3, x.allocate(33));
+    x.deallocate(p2, 1);
+    x.deallocate(p4, 100);
+}
+
+TEST(TestMyAllocator, good_fit_fallback_int) {
+    Allocator<int, 100, GoodFit> x;
+    const Allocator<int, 100, GoodFit>& xr = x;
+    Allocator<int, 100, GoodFit>::pointer p = x.allocate(21);
+    ASSERT_EQ(xr.view(0), -92);
+    x.deallocate(p, 21);
+}
+
+TEST(TestMyAllocator, free_lists_sized_to_arena_int) {
+    // 4 first-level classes cover a 100 byte arena, 28 a gigabyte one
+    ASSERT_LT(sizeof(Allocator<int, 100>), 512u);
+    Allocator<int, 100, TwoLevelFit> x;
+    const Allocator<int, 100, TwoLevelFit>& xr = x;
+    Allocator<int, 100, TwoLevelFit>::pointer p = x.allocate(23);
+    ASSERT_EQ(xr.view(0), -92);
+    x.deallocate(p, 23);
+    ASSERT_EQ(x.allocate(22), p);
+}
+
+TEST(TestMyAllocator, two_level_fit_int) {
+    Allocator<int, 1000, TwoLevelFit> x;
+    Allocator<int, 1000, TwoLevelFit>::pointer p1 = x.allocate(35);
+    Allocator<int, 1000, TwoLevelFit>::pointer p2 = x.allocate(1);
+    Allocator<int, 1000, TwoLevelFit>::pointer p3 = x.allocate(40);
+    Allocator<int, 1000, TwoLevelFit>::pointer p4 = x.allocate(100);
+    x.deallocate(p1, 35);
+    x.deallocate(p3, 40);
+    ASSERT_EQ(p3, x.allocate(33));
+    ASSERT_EQ(p1, x.allocate(32));
+    x.deallocate(p2, 1);
+    x.deallocate(p4, 100);
+}
+
+TEST(TestMyAllocator, two_level_fit_bounded_int) {
+    // a 140 byte block behind a 132 byte head, both on the [128, 144) list,
+    // and nothing bigger free
+    Allocator<int, 328, TwoLevelFit> x;
+    Allocator<int, 328, GoodFit>     y;
+    Allocator<int, 328, TwoLevelFit>::pointer p[4];
+    Allocator<int, 328, GoodFit>::pointer     q[4];
+    const int n[] = {35, 1, 33, 1};
+    for (int i = 0; i < 4; ++i) {
+        p[i] = x.allocate(n[i]);
+        q[i] = y.allocate(n[i]);}
+    ASSERT_EQ(x.stats().free_blocks, 0u);
+    x.deallocate(p[0], 35);
+    x.deallocate(p[2], 33);
+    y.deallocate(q[0], 35);
+    y.deallocate(q[2], 33);
+    bool caught = false;
+    try {
+        x.allocate(34);}
+    catch (std::bad_alloc& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(q[0], y.allocate(34));
+    x.deallocate(p[1], 1);
+    x.deallocate(p[3], 1);
+}
+
+TEST(TestMyAllocator, two_level_fit_scan_bound_int) {
+    // the same random churn against both; FirstFit's scans grow with the
+    // fragmentation, TwoLevelFit never examines more than one block
+    // both keep their counters whatever ALLOCATOR_STATS is
+    Allocator<int, 20000, TwoLevelFit, 0, alignof(int), true> x;
+    Allocator<int, 20000, FirstFit,    0, alignof(int), true> y;
+    std::vector<std::pair<int*, int> > xs, ys;
+    std::mt19937 rng(2014);
+    for (int k = 0; k < 3000; ++k) {
+        if (xs.empty() || rng() % 3 != 0) {
+            int n = 1 + rng() % 64;
+            try {
+                xs.push_back(std::make_pair(x.allocate(n), n));}
+            catch (std::bad_alloc& e) {}
+            try {
+                ys.push_back(std::make_pair(y.allocate(n), n));}
+            catch (std::bad_alloc& e) {}}
+        else {
+            std::size_t i = rng() % xs.size();
+            x.deallocate(xs[i].first, xs[i].second);
+            xs[i] = xs.back();
+            xs.pop_back();
+            if (i < ys.size()) {
+                y.deallocate(ys[i].first, ys[i].second);
+                ys[i] = ys.back();
+                ys.pop_back();}}
+        ASSERT_TRUE(x.valid());}
+    AllocatorStats s = x.stats();
+    AllocatorStats t = y.stats();
+    std::size_t longer_x = 0, longer_y = 0;
+    for (int b = AllocatorStats::bucket(2); b < AllocatorStats::SCAN_BUCKETS; ++b) {
+        longer_x += s.scans[b];
+        longer_y += t.scans[b];}
+    ASSERT_EQ(longer_x, 0u);
+    ASSERT_NE(longer_y, 0u);
+    ASSERT_GT(s.fragmentation(), 0);
+}
+
+// slab
+TEST(TestMyAllocator, slab_int) {
+    Allocator<int, 100, FirstFit, 4> x;
+    const Allocator<int, 100, FirstFit, 4>& xr = x;
+    Allocator<int, 100, FirstFit, 4>::pointer p1 = x.allocate(1);
+    Allocator<int, 100, FirstFit, 4>::pointer p2 = x.allocate(1);
+    ASSERT_EQ(p1 + 1, p2);
+    // a 12 byte header and 11 slots fill a 64 byte span
+    ASSERT_EQ(xr.view(0), -56);
+    x.deallocate(p1, 1);
+    ASSERT_EQ(p1, x.allocate(1));
+    x.deallocate(p1, 1);
+    x.deallocate(p2, 1);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, slab_char) {
+    Allocator<char, 100, FirstFit, 8> x;
+    const Allocator<char, 100, FirstFit, 8>& xr = x;
+    Allocator<char, 100, FirstFit, 8>::pointer p1 = x.allocate(1);
+    Allocator<char, 100, FirstFit, 8>::pointer p2 = x.allocate(1);
+    ASSERT_EQ(p1 + 1, p2);
+    ASSERT_EQ(xr.view(0), -24);
+    x.deallocate(p2, 1);
+    x.deallocate(p1, 1);
+}
+
+TEST(TestMyAllocator, slab_refill_int) {
+    Allocator<int, 100, FirstFit, 2> x;
+    const Allocator<int, 100, FirstFit, 2>& xr = x;
+    Allocator<int, 100, FirstFit, 2>::pointer p[4];
+    for (int i = 0; i < 4; ++i)
+        p[i] = x.allocate(1);
+    ASSERT_EQ(xr.view(0), -24);
+    ASSERT_EQ(xr.view(32), -24);
+    Allocator<int, 100, FirstFit, 2>::pointer q = x.allocate(5);
+    x.deallocate(q, 5);
+    for (int i = 0; i < 4; ++i)
+        x.deallocate(p[i], 1);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, slab_full_int) {
+    bool caught = false;
+    Allocator<int, 36, FirstFit, 8> x;
+    Allocator<int, 36, FirstFit, 8>::pointer p[4];
+    for (int i = 0; i < 4; ++i)
+        p[i] = x.allocate(1);
+    try {
+        x.allocate(1);
+    } catch (...) {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    for (int i = 0; i < 4; ++i)
+        x.deallocate(p[i], 1);
+}
+
+TEST(TestMyAllocator, slab_release_int) {
+    // empty slabs go back to the heap, so a big block fits afterwards
+    Allocator<int, 1000, FirstFit, 4> x;
+    const Allocator<int, 1000, FirstFit, 4>& xr = x;
+    std::vector<Allocator<int, 1000, FirstFit, 4>::pointer> p;
+    try {
+        while (true)
+            p.push_back(x.allocate(1));}
+    catch (std::bad_alloc& e) {}
+    ASSERT_GE(p.size(), 150u);
+    for (std::size_t i = 0; i < p.size(); ++i)
+        x.deallocate(p[i], 1);
+    ASSERT_EQ(x.stats().live_blocks, 0u);
+    ASSERT_EQ(xr.view(0), 992);
+    x.deallocate(x.allocate(100), 100);
+}
+
+TEST(TestMyAllocator, slab_double_free_int) {
+    Allocator<int, 100, FirstFit, 4> x;
+    Allocator<int, 100, FirstFit, 4>::pointer p1 = x.allocate(1);
+    Allocator<int, 100, FirstFit, 4>::pointer p2 = x.allocate(1);
+    x.deallocate(p1, 1);
+    bool caught = false;
+    try {
+        x.deallocate(p1, 1);}
+    catch (std::invalid_argument& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    Allocator<int, 100, FirstFit, 4>::pointer q[] = {p2, p2};
+    caught = false;
+    try {
+        x.deallocate_batch(q, 2, 1);}
+    catch (std::invalid_argument& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    ASSERT_TRUE(x.valid());
+    x.deallocate(p2, 1);
+    ASSERT_EQ(x.stats().live_blocks, 0u);
+}
+
+// concurrent
+TEST(TestMyAllocator, concurrent_magazine_int) {
+    ConcurrentAllocator<int, 1000> x;
+    ConcurrentAllocator<int, 1000>::pointer p1 = x.allocate(1);
+    x.deallocate(p1, 1);
+    ASSERT_EQ(p1, x.allocate(1));
+    x.deallocate(p1, 1);
+    ASSERT_TRUE(x.valid());
+}
+
+TEST(TestMyAllocator, concurrent_flush_int) {
+    ConcurrentAllocator<int, 1000> x;
+    std::vector<int*> v;
+    for (int i = 0; i < 40; ++i)
+        v.push_back(x.allocate(1));
+    for (int i = 0; i < 40; ++i)
+        x.deallocate(v[i], 1);
+    x.flush();
+    ASSERT_TRUE(x.valid());
+    int* p = x.allocate(248);
+    x.deallocate(p, 248);
+}
+
+TEST(TestMyAllocator, concurrent_precondition_int) {
+    // requests that can never fit fail without flushing the magazines
+    ConcurrentAllocator<int, 100> x;
+    x.deallocate(x.allocate(1), 1);
+    const std::size_t n[] = {0, 24};
+    for (int i = 0; i < 2; ++i) {
+        bool caught = false;
+        try {
+            x.allocate(n[i]);}
+        catch (std::bad_alloc& e) {
+            caught = true;}
+        ASSERT_TRUE(caught);}
+    ASSERT_NE(x.stats().live_blocks, 0u);
+    x.deallocate(x.allocate(23), 23);
+    ASSERT_EQ(x.stats().live_blocks, 0u);
+}
+
+TEST(TestMyAllocator, concurrent_stress_int) {
+    typedef ConcurrentAllocator<int, 100000> allocator_type;
+    allocator_type x;
+    std::mutex handoff_lock;
+    std::vector<int*> handoff;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 8; ++t)
+        workers.push_back(std::thread([&x, &handoff_lock, &handoff, t] () {
+            std::vector<int*> mine;
+            for (int i = 0; i < 5000; ++i) {
+                int* p = x.allocate(1);
+                x.construct(p, t);
+                mine.push_back(p);
+                if (i % 7 == 0) {
+                    int* q = x.allocate(5);
+                    x.deallocate(q, 5);}
+                if (mine.size() == 32) {
+                    std::lock_guard<std::mutex> guard(handoff_lock);
+                    // free half of our objects and half of someone else's
+                    for (int j = 0; j < 16; ++j) {
+                        x.destroy(mine.back());
+                        x.deallocate(mine.back(), 1);
+                        mine.pop_back();}
+                    for (int j = 0; j < 16; ++j)
+                        handoff.push_back(mine[j]);
+                    mine.clear();
+                    while (handoff.size() > 64) {
+                        x.destroy(handoff.back());
+                        x.deallocate(handoff.back(), 1);
+                        handoff.pop_back();}}}
+            for (std::size_t j = 0; j < mine.size(); ++j)
+                x.deallocate(mine[j], 1);}));
+    for (int t = 0; t < 8; ++t)
+        workers[t].join();
+
+    ASSERT_TRUE(x.valid());
+    for (std::size_t j = 0; j < handoff.size(); ++j)
+        x.deallocate(handoff[j], 1);
+    x.flush();
+    ASSERT_TRUE(x.valid());
+    int* p = x.allocate(24998);
+    x.deallocate(p, 24998);
+}
+
+// a placement policy that parks the search until the test opens the gate,
+// so a thread can be held inside a magazine refill
+struct GatedFit {
+    static std::atomic<bool> open;
+    static std::atomic<bool> waiting;
+
+    template <typename H>
+    typename H::sentinel_type find (const H& h, typename H::sentinel_type bytes) {
+        waiting = true;
+        while (!open)
+            std::this_thread::yield();
+        waiting = false;
+        int c = h.size_class(std::max(bytes, h.LINK_SIZE));
+        c = h.next_class((bytes <= h.class_min(c)) ? c : c + 1);
+        return (c == -1) ? -1 : h.free_lists[c];}
+
+    template <typename H>
+    void unlinked (const H&, typename H::sentinel_type) {}};
+
+std::atomic<bool> GatedFit::open(true);
+std::atomic<bool> GatedFit::waiting(false);
+
+TEST(TestMyAllocator, concurrent_return_stack_int) {
+    // one magazine, held by a thread refilling it, so frees from another
+    // thread have to go onto the return stack
+    typedef ConcurrentAllocator<int, 1000, GatedFit, 16, 1> allocator_type;
+    allocator_type x;
+    int* p[8];
+    for (int i = 0; i < 8; ++i)
+        p[i] = x.allocate(1);
+
+    GatedFit::open = false;
+    int* r = 0;
+    std::thread refiller([&x, &r] () {
+        r = x.allocate(1);});
+    while (!GatedFit::waiting)
+        std::this_thread::yield();
+    for (int i = 0; i < 8; ++i)
+        x.deallocate(p[i], 1);
+    GatedFit::open = true;
+    refiller.join();
+
+    // take the refill's blocks, then the next refill drains the return
+    // stack, whose bottom is the first block freed
+    int* q[7];
+    for (int i = 0; i < 7; ++i)
+        q[i] = x.allocate(1);
+    int* s = x.allocate(1);
+    ASSERT_EQ(s, p[0]);
+    ASSERT_TRUE(x.valid());
+
+    x.deallocate(r, 1);
+    x.deallocate(s, 1);
+    for (int i = 0; i < 7; ++i)
+        x.deallocate(q[i], 1);
+    x.flush();
+    ASSERT_TRUE(x.valid());
+    AllocatorStats t = x.stats();
+    ASSERT_EQ(t.live_blocks, 0u);
+    ASSERT_EQ(t.free_blocks, 1u);
+}
+
+// alignment
+TEST(TestMyAllocator, align_double) {
+    Allocator<double, 100> x;
+    Allocator<double, 100>::pointer p1 = x.allocate(1);
+    Allocator<double, 100>::pointer p2 = x.allocate(3);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p1) % alignof(double), 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % alignof(double), 0u);
+    x.deallocate(p1, 1);
+    x.deallocate(p2, 3);
+}
+
+TEST(TestMyAllocator, align_char_16) {
+    Allocator<char, 1000, FirstFit, 0, 16> x;
+    const Allocator<char, 1000, FirstFit, 0, 16>& xr = x;
+    Allocator<char, 1000, FirstFit, 0, 16>::pointer p1 = x.allocate(3);
+    Allocator<char, 1000, FirstFit, 0, 16>::pointer p2 = x.allocate(20);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p1) % 16, 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 16, 0u);
+    ASSERT_EQ(xr.view(0), -8);
+    ASSERT_EQ(xr.view(16), -24);
+    x.deallocate(p1, 3);
+    x.deallocate(p2, 20);
+    ASSERT_EQ(xr.view(0), 984);
+}
+
+TEST(TestMyAllocator, align_slab_double_64) {
+    Allocator<double, 1000, FirstFit, 4, 64> x;
+    Allocator<double, 1000, FirstFit, 4, 64>::pointer p1 = x.allocate(1);
+    Allocator<double, 1000, FirstFit, 4, 64>::pointer p2 = x.allocate(1);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p1) % 64, 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 64, 0u);
+    x.deallocate(p1, 1);
+    x.deallocate(p2, 1);
+}
+
+TEST(TestMyAllocator, allocate_aligned_int) {
+    Allocator<int, 1000> x;
+    const Allocator<int, 1000>& xr = x;
+    Allocator<int, 1000>::pointer p1 = x.allocate(1);
+    Allocator<int, 1000>::pointer p2 = x.allocate_aligned(8, 64);
+    Allocator<int, 1000>::pointer p3 = x.allocate_aligned(1, 32);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 64, 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p3) % 32, 0u);
+    x.deallocate(p2, 8);
+    x.deallocate(p1, 1);
+    x.deallocate(p3, 1);
+    ASSERT_EQ(xr.view(0), 992);
+}
+
+TEST(TestMyAllocator, allocate_aligned_small_char) {
+    // align is smaller than two sentinels, so the gap in front grows by it
+    // until the free block left there has a payload
+    Allocator<char, 100> x;
+    const Allocator<char, 100>& xr = x;
+    Allocator<char, 100>::pointer p1 = x.allocate(1);
+    Allocator<char, 100>::pointer p2 = x.allocate_aligned(3, 4);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 4, 0u);
+    ASSERT_TRUE(x.valid());
+    x.deallocate(p1, 1);
+    x.deallocate(p2, 3);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, allocate_aligned_mmap_int) {
+    typedef BasicAllocator<int, MmapArena> allocator_type;
+    allocator_type x((MmapArena(4096)));
+    allocator_type::pointer p1 = x.allocate(1);
+    allocator_type::pointer p2 = x.allocate_aligned(2, 8);
+    allocator_type::pointer p3 = x.allocate_aligned(3, 16);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 8, 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p3) % 16, 0u);
+    ASSERT_TRUE(x.valid());
+    x.deallocate(p2, 2);
+    x.deallocate(p1, 1);
+    x.deallocate(p3, 3);
+    ASSERT_EQ(x.stats().free_blocks, 1u);
+}
+
+TEST(TestMyAllocator, allocate_aligned_gap_long) {
+    // the 24 byte gap in front of p2 can't hold two sentinels and the links,
+    // so it grows by 64 and the free block left there can be reused
+    typedef BasicAllocator<long, MmapArena> allocator_type;
+    allocator_type x((MmapArena(4096)));
+    allocator_type::pointer p1 = x.allocate(2);
+    allocator_type::pointer p2 = x.allocate_aligned(1, 64);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % 64, 0u);
+    allocator_type::pointer p3 = x.allocate(1);
+    ASSERT_LT(p3, p2);
+    x.deallocate(p1, 2);
+    x.deallocate(p2, 1);
+    x.deallocate(p3, 1);
+    ASSERT_EQ(x.stats().free_blocks, 1u);
+}
+
+TEST(TestMyAllocator, allocate_aligned_bad_int) {
+    bool caught = false;
+    try {
+        Allocator<int, 100> x;
+        x.allocate_aligned(1, 12);
+    } catch (std::invalid_argument&) {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+}
+
+TEST(TestMyAllocator, allocate_aligned_slab_char) {
+    Allocator<char, 200, FirstFit, 4> x;
+    bool caught = false;
+    try {
+        x.allocate_aligned(1, 16);
+    } catch (std::invalid_argument&) {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    Allocator<char, 200, FirstFit, 4>::pointer p = x.allocate_aligned(2, 16);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 16, 0u);
+    x.deallocate(p, 2);
+    Allocator<char, 200, FirstFit, 4>::pointer q = x.allocate(1);
+    x.deallocate(q, 1);
+    ASSERT_TRUE(x.valid());
+}
+
+// reallocate
+TEST(TestMyAllocator, expand_in_place_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(2);
+    Allocator<int, 100>::pointer p2 = x.allocate(2);
+    Allocator<int, 100>::pointer p3 = x.allocate(2);
+    x.deallocate(p2, 2);
+    p1[0] = 111;
+    p1[1] = 222;
+    ASSERT_TRUE(x.try_expand_in_place(p1, 2, 4));
+    ASSERT_EQ(p1[0], 111);
+    ASSERT_EQ(p1[1], 222);
+    ASSERT_EQ(xr.view(0), -24);
+    ASSERT_EQ(xr.view(28), -24);
+    ASSERT_TRUE(x.try_expand_in_place(p1, 4, 6));
+    ASSERT_EQ(p1[0], 111);
+    ASSERT_EQ(p1[1], 222);
+    ASSERT_FALSE(x.try_expand_in_place(p1, 6, 7));
+    x.deallocate(p1, 6);
+    x.deallocate(p3, 2);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, expand_in_place_split_int) {
+    // the grown block keeps its data, and the rest of the merged block is
+    // split off and linked
+    Allocator<int, 200> x;
+    Allocator<int, 200>::pointer p = x.allocate(2);
+    Allocator<int, 200>::pointer q = x.allocate(10);
+    Allocator<int, 200>::pointer r = x.allocate(2);
+    x.deallocate(q, 10);
+    p[0] = 111;
+    p[1] = 222;
+    ASSERT_TRUE(x.try_expand_in_place(p, 2, 6));
+    ASSERT_EQ(p[0], 111);
+    ASSERT_EQ(p[1], 222);
+    ASSERT_TRUE(x.valid());
+    ASSERT_EQ(x.stats().free_blocks, 2u);
+    x.deallocate(p, 6);
+    x.deallocate(r, 2);
+    ASSERT_EQ(x.stats().free_blocks, 1u);
+}
+
+TEST(TestMyAllocator, expand_in_place_used_int) {
+    Allocator<int, 100> x;
+    Allocator<int, 100>::pointer p1 = x.allocate(2);
+    Allocator<int, 100>::pointer p2 = x.allocate(2);
+    ASSERT_FALSE(x.try_expand_in_place(p1, 2, 3));
+    x.deallocate(p1, 2);
+    x.deallocate(p2, 2);
+}
+
+TEST(TestMyAllocator, shrink_in_place_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(10);
+    Allocator<int, 100>::pointer p2 = x.allocate(1);
+    ASSERT_TRUE(x.shrink_in_place(p1, 10, 2));
+    ASSERT_EQ(xr.view(0), -8);
+    ASSERT_EQ(xr.view(16), 24);
+    ASSERT_EQ(p1 + 4, x.allocate(6));
+    x.deallocate(p1, 2);
+    x.deallocate(p2, 1);
+}
+
+TEST(TestMyAllocator, shrink_in_place_tail_int) {
+    // an 8 byte tail can't hold two sentinels and the links, a 16 byte one can
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(4);
+    Allocator<int, 100>::pointer p2 = x.allocate(6);
+    Allocator<int, 100>::pointer p3 = x.allocate(1);
+    ASSERT_TRUE(x.shrink_in_place(p1, 4, 2));
+    ASSERT_EQ(xr.view(0), -16);
+    ASSERT_TRUE(x.shrink_in_place(p2, 6, 1));
+    ASSERT_EQ(xr.view(24), -8);
+    ASSERT_EQ(xr.view(40), 8);
+    ASSERT_EQ(x.allocate(1), p2 + 4);
+    x.deallocate(p1, 2);
+    x.deallocate(p2, 1);
+    x.deallocate(p2 + 4, 1);
+    x.deallocate(p3, 1);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, shrink_in_place_merge_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(10);
+    ASSERT_TRUE(x.shrink_in_place(p1, 10, 3));
+    ASSERT_EQ(xr.view(0), -12);
+    ASSERT_EQ(xr.view(20), 72);
+    x.deallocate(p1, 3);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, reallocate_double) {
+    Allocator<double, 200> x;
+    Allocator<double, 200>::pointer p1 = x.allocate(2);
+    Allocator<double, 200>::pointer p2 = x.allocate(1);
+    x.construct(p1, 1.5);
+    x.construct(p1 + 1, 2.5);
+    Allocator<double, 200>::pointer p3 = x.reallocate(p1, 2, 4);
+    ASSERT_NE(p1, p3);
+    ASSERT_EQ(p3[0], 1.5);
+    ASSERT_EQ(p3[1], 2.5);
+    ASSERT_EQ(p3, x.reallocate(p3, 4, 6));
+    ASSERT_EQ(p3[0], 1.5);
+    ASSERT_EQ(p3[1], 2.5);
+    x.destroy(p3);
+    x.destroy(p3 + 1);
+    x.deallocate(p3, 6);
+    x.deallocate(p2, 1);
+}
+
+TEST(TestMyAllocator, reallocate_slab_int) {
+    Allocator<int, 200, FirstFit, 4> x;
+    Allocator<int, 200, FirstFit, 4>::pointer p1 = x.allocate(1);
+    x.construct(p1, 7);
+    ASSERT_FALSE(x.try_expand_in_place(p1, 1, 2));
+    Allocator<int, 200, FirstFit, 4>::pointer p2 = x.reallocate(p1, 1, 3);
+    ASSERT_EQ(p2[0], 7);
+    Allocator<int, 200, FirstFit, 4>::pointer p3 = x.reallocate(p2, 3, 1);
+    ASSERT_EQ(p3[0], 7);
+    x.destroy(p3);
+    x.deallocate(p3, 1);
+}
+
+// arenas
+TEST(TestMyAllocator, buffer_arena_double) {
+    char buffer[1003];
+    BasicAllocator<double, BufferArena> x(BufferArena(buffer + 3, 1000));
+    BasicAllocator<double, BufferArena>::pointer p1 = x.allocate(1);
+    BasicAllocator<double, BufferArena>::pointer p2 = x.allocate(10);
+    ASSERT_GE(reinterpret_cast<char*>(p1), buffer + 3);
+    ASSERT_LE(reinterpret_cast<char*>(p2 + 10), buffer + 1003);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p1) % alignof(double), 0u);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p2) % alignof(double), 0u);
+    x.deallocate(p1, 1);
+    x.deallocate(p2, 10);
+    ASSERT_TRUE(x.valid());
+}
+
+TEST(TestMyAllocator, buffer_arena_reuse_double) {
+    // a single double is smaller than the 16 bytes of 64-bit links
+    alignas(8) char buffer[4096];
+    typedef BasicAllocator<double, BufferArena> allocator_type;
+    allocator_type x(BufferArena(buffer, sizeof(buffer)));
+    std::vector<allocator_type::pointer> p;
+    try {
+        while (true)
+            p.push_back(x.allocate(1));}
+    catch (std::bad_alloc& e) {}
+    for (std::size_t i = 0; i < p.size(); i += 2)
+        x.deallocate(p[i], 1);
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.free_blocks, (p.size() + 1) / 2);
+    for (std::size_t i = 0; i < s.free_blocks; ++i)
+        x.allocate(1);
+    ASSERT_EQ(x.stats().free_blocks, 0u);
+    ASSERT_TRUE(x.valid());
+}
+
+TEST(TestMyAllocator, buffer_arena_too_small) {
+    bool caught = false;
+    char buffer[20];
+    try {
+        BasicAllocator<double, BufferArena> x(BufferArena(buffer, 20));
+    } catch (std::bad_alloc&) {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+}
+
+TEST(TestMyAllocator, mmap_arena_int) {
+    BasicAllocator<int, MmapArena> x(MmapArena(1 << 20));
+    const BasicAllocator<int, MmapArena>& xr = x;
+    BasicAllocator<int, MmapArena>::pointer p1 = x.allocate(1000);
+    BasicAllocator<int, MmapArena>::pointer p2 = x.allocate(1);
+    ASSERT_EQ(xr.view(0), -4000);
+    x.deallocate(p1, 1000);
+    x.deallocate(p2, 1);
+    ASSERT_EQ(xr.view(0), (1 << 20) - 16);
+}
+
+TEST(TestMyAllocator, mmap_arena_move_int) {
+    BasicAllocator<int, MmapArena> x(MmapArena(1 << 16));
+    BasicAllocator<int, MmapArena>::pointer p = x.allocate(10);
+    BasicAllocator<int, MmapArena> y(std::move(x));
+    y.deallocate(p, 10);
+    ASSERT_TRUE(y.valid());
+    ASSERT_TRUE(x.valid());
+    ASSERT_EQ(x.stats().free_blocks, 0u);
+}
+
+TEST(TestMyAllocator, mmap_arena_move_assign_int) {
+    typedef BasicAllocator<int, MmapArena> allocator_type;
+    allocator_type x((MmapArena(1 << 16)));
+    allocator_type y((MmapArena(1 << 12)));
+    allocator_type::pointer p = x.allocate(10);
+    y = std::move(x);
+    y.deallocate(p, 10);
+    ASSERT_TRUE(y.valid());
+    ASSERT_EQ(y.stats().free_bytes, (1u << 16) - 16);
+    // x now holds y's old mapping, freshly formatted
+    ASSERT_TRUE(x.valid());
+    ASSERT_EQ(x.stats().free_bytes, (1u << 12) - 16);
+    x.deallocate(x.allocate(5), 5);
+}
+
+TEST(TestMyAllocator, buffer_arena_moved_from_int) {
+    // a moved-from BufferArena is empty, so its allocator has nothing left
+    alignas(8) char buffer[256];
+    typedef BasicAllocator<int, BufferArena> allocator_type;
+    allocator_type x(BufferArena(buffer, sizeof(buffer)));
+    allocator_type::pointer p = x.allocate(4);
+    allocator_type y(std::move(x));
+    ASSERT_TRUE(x.valid());
+    x.reset();
+    ASSERT_TRUE(x.valid());
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.free_blocks, 0u);
+    ASSERT_EQ(s.live_blocks, 0u);
+    y.deallocate(p, 4);
+    ASSERT_TRUE(y.valid());
+}
+
+TEST(TestMyAllocator, arena_copy_semantics) {
+    ASSERT_TRUE((std::is_copy_constructible<Allocator<int, 100> >::value));
+    ASSERT_TRUE((std::is_copy_assignable<Allocator<int, 100> >::value));
+    ASSERT_FALSE((std::is_copy_constructible<BasicAllocator<int, BufferArena> >::value));
+    ASSERT_FALSE((std::is_copy_assignable<BasicAllocator<int, BufferArena> >::value));
+    ASSERT_TRUE((std::is_move_constructible<BasicAllocator<int, BufferArena> >::value));
+    ASSERT_TRUE((std::is_move_assignable<BasicAllocator<int, MmapArena> >::value));
+    Allocator<int, 100> x;
+    Allocator<int, 100> y;
+    const Allocator<int, 100>& yr = y;
+    Allocator<int, 100>::pointer p = x.allocate(3);
+    y = x;
+    ASSERT_EQ(yr.view(0), -12);
+    x.deallocate(p, 3);
+}
+
+TEST(TestMyAllocator, mmap_arena_huge_pages_long) {
+    BasicAllocator<long, MmapArena, BestFit, 0, 64> x(MmapArena(1 << 21, true));
+    BasicAllocator<long, MmapArena, BestFit, 0, 64>::pointer p = x.allocate(100000);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 64, 0u);
+    x.deallocate(p, 100000);
+    ASSERT_TRUE(x.valid());
+}
+
+TEST(TestMyAllocator, mmap_arena_gigabytes_char) {
+    const long long size = (3LL << 30);
+    BasicAllocator<char, MmapArena> x((MmapArena(size)));
+    const BasicAllocator<char, MmapArena>& xr = x;
+    BasicAllocator<char, MmapArena>::pointer p1 = x.allocate(5LL << 29);
+    BasicAllocator<char, MmapArena>::pointer p2 = x.allocate(1);
+    ASSERT_EQ(xr.view(0), -(5LL << 29));
+    x.deallocate(p1, 5LL << 29);
+    x.deallocate(p2, 1);
+    ASSERT_EQ(xr.view(0), size - 16);
+}
+
+// batches
+TEST(TestMyAllocator, allocate_batch_int) {
+    Allocator<int, 1000> x;
+    const Allocator<int, 1000>& xr = x;
+    Allocator<int, 1000>::pointer p[10];
+    x.allocate_batch(10, 3, p);
+    for (int i = 1; i < 10; ++i)
+        ASSERT_EQ(p[i] - p[i - 1], 5);
+    ASSERT_EQ(xr.view(0), -12);
+#if ALLOCATOR_STATS
+    ASSERT_EQ(x.stats().allocations, 10u);
+    ASSERT_EQ(x.stats().scans[1], 1u);
+#endif
+    x.deallocate_batch(p, 10, 3);
+    ASSERT_EQ(xr.view(0), 992);
+}
+
+TEST(TestMyAllocator, allocate_batch_small_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p[6];
+    x.allocate_batch(6, 1, p);
+    for (int i = 1; i < 6; ++i)
+        ASSERT_EQ(p[i] - p[i - 1], 4);
+    ASSERT_EQ(xr.view(80), -12);
+    x.deallocate_batch(p, 6, 1);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, allocate_batch_fallback_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(3);
+    Allocator<int, 100>::pointer p2 = x.allocate(5);
+    Allocator<int, 100>::pointer p3 = x.allocate(2);
+    x.deallocate(p2, 5);
+    Allocator<int, 100>::pointer p[2];
+    x.allocate_batch(2, 5, p);
+    ASSERT_EQ(p[0], p2);
+    ASSERT_EQ(xr.view(64), -28);
+    ASSERT_EQ(x.stats().free_blocks, 0u);
+    x.deallocate_batch(p, 2, 5);
+    x.deallocate(p1, 3);
+    x.deallocate(p3, 2);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, allocate_batch_fail_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p[5];
+    bool caught = false;
+    try {
+        x.allocate_batch(5, 5, p);}
+    catch (std::bad_alloc& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(xr.view(0), 92);
+#if ALLOCATOR_STATS
+    ASSERT_EQ(x.stats().allocations, 0u);
+    ASSERT_EQ(x.stats().failed_allocations, 1u);
+#endif
+}
+
+TEST(TestMyAllocator, allocate_batch_slab_int) {
+    Allocator<int, 100, FirstFit, 4> x;
+    Allocator<int, 100, FirstFit, 4>::pointer p[6];
+    x.allocate_batch(6, 1, p);
+    std::sort(p, p + 6);
+    ASSERT_TRUE(std::unique(p, p + 6) == p + 6);
+    x.deallocate_batch(p, 6, 1);
+    ASSERT_TRUE(x.valid());
+}
+
+TEST(TestMyAllocator, deallocate_batch_runs_int) {
+    Allocator<int, 1000> x;
+    const Allocator<int, 1000>& xr = x;
+    Allocator<int, 1000>::pointer p[6];
+    for (int i = 0; i < 6; ++i)
+        p[i] = x.allocate(2);
+    Allocator<int, 1000>::pointer q[] = {p[4], p[0], p[5], p[1]};
+    x.deallocate_batch(q, 4, 2);
+    ASSERT_EQ(xr.view(0), 24);
+    ASSERT_EQ(xr.view(64), 928);
+    ASSERT_EQ(x.stats().free_blocks, 2u);
+    x.deallocate(p[2], 2);
+    x.deallocate(p[3], 2);
+    ASSERT_EQ(xr.view(0), 992);
+}
+
+TEST(TestMyAllocator, deallocate_batch_twice_int) {
+    Allocator<int, 100> x;
+    const Allocator<int, 100>& xr = x;
+    Allocator<int, 100>::pointer p1 = x.allocate(2);
+    Allocator<int, 100>::pointer p2 = x.allocate(2);
+    Allocator<int, 100>::pointer q[] = {p2, p1, p2};
+    bool caught = false;
+    try {
+        x.deallocate_batch(q, 3, 2);}
+    catch (std::invalid_argument& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(xr.view(0), -8);
+    ASSERT_EQ(xr.view(16), -8);
+    x.deallocate_batch(q, 2, 2);
+    ASSERT_EQ(xr.view(0), 92);
+}
+
+TEST(TestMyAllocator, reset_int) {
+    Allocator<int, 100, NextFit, 4> x;
+    const Allocator<int, 100, NextFit, 4>& xr = x;
+    x.allocate(1);
+    x.allocate(1);
+    x.allocate(3);
+    x.reset();
+    ASSERT_EQ(xr.view(0), 92);
+    ASSERT_TRUE(x.valid());
+    Allocator<int, 100, NextFit, 4>::pointer p = x.allocate(3);
+    ASSERT_EQ(xr.view(0), -12);
+    x.deallocate(p, 3);
+}
+
+// scopes
+TEST(TestMyAllocator, scope_char) {
+    Allocator<char, 1000> x;
+    const Allocator<char, 1000>& xr = x;
+    {
+        Scope<Allocator<char, 1000> > s(x, 200);
+        ASSERT_EQ(xr.view(0), -200);
+        int* a = s.allocate<int>(3);
+        a[0] = a[1] = a[2] = 1;
+        Scope<Allocator<char, 1000> >::mark_type m = s.mark();
+        s.allocate<char>();
+        double* d = s.allocate<double>(4);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(d) % alignof(double), 0u);
+        s.release(m);
+        s.allocate<char>();
+        ASSERT_EQ(s.allocate<double>(4), d);
+        bool caught = false;
+        try {
+            s.allocate<double>(100);}
+        catch (std::bad_alloc& e) {
+            caught = true;}
+        ASSERT_TRUE(caught);
+        s.reset();
+        ASSERT_EQ(s.allocate<int>(), a);
+        ASSERT_EQ(s.capacity(), 200u);
+    }
+    ASSERT_EQ(xr.view(0), 992);
+}
+
+TEST(TestMyAllocator, scope_byte_heap) {
+    ByteHeap<MmapArena> h((MmapArena(1 << 16)));
+    {
+        Scope<ByteHeap<MmapArena> > s(h, 4096);
+        for (int i = 0; i < 100; ++i)
+            *s.allocate<long>() = i;
+        ASSERT_EQ(s.used(), 800u);
+        ASSERT_EQ(h.stats().live_blocks, 1u);
+    }
+    ASSERT_EQ(h.stats().live_blocks, 0u);
+}
+
+// stats
+TEST(TestMyAllocator, stats_int) {
+    Allocator<int, 100> x;
+    Allocator<int, 100>::pointer p1 = x.allocate(3);
+    Allocator<int, 100>::pointer p2 = x.allocate(5);
+    Allocator<int, 100>::pointer p3 = x.allocate(2);
+    x.deallocate(p2, 5);
+    bool caught = false;
+    try {
+        x.allocate(8);}
+    catch (std::bad_alloc& e) {
+        caught = true;}
+    ASSERT_TRUE(caught);
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.live_blocks, 2u);
+    ASSERT_EQ(s.live_bytes, 20u);
+    ASSERT_EQ(s.free_blocks, 2u);
+    ASSERT_EQ(s.free_bytes, 48u);
+    ASSERT_EQ(s.largest_free, 28u);
+    ASSERT_DOUBLE_EQ(s.fragmentation(), 1 - 28.0 / 48);
+#if ALLOCATOR_STATS
+    ASSERT_EQ(s.allocations, 3u);
+    ASSERT_EQ(s.deallocations, 1u);
+    ASSERT_EQ(s.failed_allocations, 1u);
+    ASSERT_EQ(s.scans[0], 1u);
+    ASSERT_EQ(s.scans[1], 3u);
+#endif
+    x.deallocate(p1, 3);
+    x.deallocate(p3, 2);
+    ASSERT_EQ(x.stats().fragmentation(), 0);
+}
+
+TEST(TestMyAllocator, stats_reset_int) {
+    Allocator<int, 100> x;
+    Allocator<int, 100>::pointer p = x.allocate(3);
+    x.reset_stats();
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.allocations, 0u);
+    ASSERT_EQ(s.scans[1], 0u);
+    ASSERT_EQ(s.live_bytes, 12u);
+    x.deallocate(p, 3);
+}
+
+TEST(TestMyAllocator, stats_scan_histogram_int) {
+    Allocator<int, 1000> x;
+    Allocator<int, 1000>::pointer p[5];
+    Allocator<int, 1000>::pointer q[5];
+    for (int i = 0; i < 5; ++i) {
+        p[i] = x.allocate(32);
+        q[i] = x.allocate(1);}
+    for (int i = 0; i < 5; ++i)
+        x.deallocate(p[i], 32);
+    x.reset_stats();
+    Allocator<int, 1000>::pointer r = x.allocate(35);
+    // five 128 byte blocks on the same list that don't fit, then the rest of the arena
+    AllocatorStats s = x.stats();
+#if ALLOCATOR_STATS
+    ASSERT_EQ(s.scans[AllocatorStats::bucket(6)], 1u);
+#endif
+    ASSERT_EQ(AllocatorStats::bucket(6), 3);
+    ASSERT_EQ(s.free_blocks, 6u);
+    x.deallocate(r, 35);
+    for (int i = 0; i < 5; ++i)
+        x.deallocate(q[i], 1);
+    ASSERT_EQ(x.stats().free_blocks, 1u);
+}
+
+TEST(TestMyAllocator, stats_off_int) {
+    // without STATS the counters take no space and stay 0
+    typedef Allocator<int, 100, FirstFit, 0, alignof(int), false> allocator_type;
+    ASSERT_GE(sizeof(Allocator<int, 100, FirstFit, 0, alignof(int), true>),
+              sizeof(allocator_type) + sizeof(AllocatorStats));
+    allocator_type x;
+    allocator_type::pointer p = x.allocate(3);
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.allocations, 0u);
+    ASSERT_EQ(s.scans[1], 0u);
+    ASSERT_EQ(s.live_bytes, 12u);
+    x.deallocate(p, 3);
+}
+
+TEST(TestMyAllocator, stats_slab_int) {
+    Allocator<int, 100, FirstFit, 4> x;
+    Allocator<int, 100, FirstFit, 4>::pointer p = x.allocate(1);
+    AllocatorStats s = x.stats();
+    ASSERT_EQ(s.live_blocks, 1u);
+    ASSERT_EQ(s.live_bytes, 56u);
+#if ALLOCATOR_STATS
+    ASSERT_EQ(s.allocations, 1u);
+#endif
+    x.deallocate(p, 1);
+#if ALLOCATOR_STATS
+    ASSERT_EQ(x.stats().deallocations, 1u);
+#endif
+}
+
+TEST(TestMyAllocator, stats_concurrent_int) {
+    ConcurrentAllocator<int, 100> x;
+    x.deallocate(x.allocate(1), 1);
+    ASSERT_NE(x.stats().live_blocks, 0u);
+    x.flush();
+    ASSERT_EQ(x.stats().live_blocks, 0u);
+}
+
+// heap walk
+TEST(TestMyAllocator, blocks_int) {
+    typedef Allocator<int, 100> allocator_type;
+    allocator_type x;
+    allocator_type::pointer p1 = x.allocate(3);
+    allocator_type::pointer p2 = x.allocate(5);
+    allocator_type::pointer p3 = x.allocate(2);
+    x.deallocate(p2, 5);
+    const std::size_t offsets[] = {0, 20, 48, 64};
+    const std::size_t bytes[]   = {12, 20, 8, 28};
+    int i = 0;
+    for (allocator_type::block b : x.blocks()) {
+        ASSERT_LT(i, 4);
+        ASSERT_EQ(b.offset, offsets[i]);
+        ASSERT_EQ(b.bytes, bytes[i]);
+        ASSERT_EQ(b.used, i % 2 == 0);
+        ++i;}
+    ASSERT_EQ(i, 4);
+    ASSERT_EQ((*x.blocks().begin()).payload, p1);
+    x.deallocate(p1, 3);
+    x.deallocate(p3, 2);
+}
+
+TEST(TestMyAllocator, blocks_mmap_long) {
+    typedef BasicAllocator<long, MmapArena> allocator_type;
+    allocator_type x((MmapArena(1 << 16)));
+    allocator_type::pointer p = x.allocate(10);
+    allocator_type::block_iterator b = x.blocks().begin();
+    ASSERT_TRUE((*b).used);
+    ASSERT_EQ((*b).payload, p);
+    ASSERT_FALSE((*++b).used);
+    ASSERT_TRUE(++b == x.blocks().end());
+    x.deallocate(p, 10);
+}
+
+// equality
+TEST(TestMyAllocator, equal_int) {
+    Allocator<int, 100> x;
+    Allocator<int, 100> y;
+    ASSERT_TRUE(x == x);
+    ASSERT_TRUE(x != y);
+}
+
+// heap allocator
+TEST(TestMyAllocator, heap_allocator_equal) {
+    ByteHeap<MmapArena> h1((MmapArena(1 << 16)));
+    ByteHeap<MmapArena> h2((MmapArena(1 << 16)));
+    HeapAllocator<int> a1(h1);
+    HeapAllocator<int> a2(h2);
+    HeapAllocator<double> b1(a1);
+    HeapAllocator<int>::rebind<long>::other c1(b1);
+    ASSERT_TRUE(a1 == b1);
+    ASSERT_TRUE(b1 == c1);
+    ASSERT_TRUE(a1 != a2);
+    ASSERT_TRUE(HeapAllocator<int>(h1) == a1);
+}
+
+TEST(TestMyAllocator, heap_allocator_vector) {
+    typedef ByteHeap<MmapArena> heap_type;
+    heap_type h((MmapArena(1 << 20)));
+    const heap_type& hr = h;
+    {
+        std::vector<int, HeapAllocator<int> > v((HeapAllocator<int>(h)));
+        for (int i = 0; i < 10000; ++i)
+            v.push_back(i);
+        ASSERT_EQ(v[9999], 9999);
+        ASSERT_TRUE(h.valid());
+    }
+    // 8 bytes skipped at the front, 8 trimmed off the back, two sentinels
+    ASSERT_EQ(hr.view(0), (1 << 20) - 8 - 8 - 16);
+}
+
+TEST(TestMyAllocator, heap_allocator_node_containers) {
+    typedef ByteHeap<FixedArena<100000, 16>, BestFit> heap_type;
+    typedef std::map<int, double, std::less<int>, HeapAllocator<std::pair<const int, double>, heap_type> > map_type;
+    typedef std::list<double, HeapAllocator<double, heap_type> > list_type;
+    heap_type h;
+    const heap_type& hr = h;
+    {
+        HeapAllocator<char, heap_type> a(h);
+        map_type m(std::less<int>(), a);
+        list_type l(a);
+        for (int i = 0; i < 500; ++i) {
+            m[i] = i * 0.5;
+            l.push_back(i * 0.25);}
+        list_type k(a);
+        k.splice(k.begin(), l);
+        ASSERT_EQ(m[499], 249.5);
+        ASSERT_EQ(k.size(), 500u);
+        ASSERT_TRUE(h.valid());
+    }
+    ASSERT_EQ(hr.view(0), 100000 - 8);
 }